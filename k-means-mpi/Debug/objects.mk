@@ -2,7 +2,7 @@
 # Automatically-generated file. Do not edit!
 ################################################################################
 
-USER_OBJS :=
+USER_OBJS := ../../libkmeans/libkmeans.a
 
-LIBS := -lmpich
+LIBS := -lmpich -lm -lpthread
 
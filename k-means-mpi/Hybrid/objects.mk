@@ -0,0 +1,8 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+USER_OBJS := ../../libkmeans/libkmeans-openmp.a
+
+LIBS := -lmpich -lm -lpthread
+
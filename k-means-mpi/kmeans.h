@@ -14,13 +14,13 @@
 #include <string.h>
 #include <unistd.h>
 #include <float.h>
+#include <limits.h>
 #include <math.h>
+#include <time.h>
 #include <mpi.h>
-
-typedef struct{
-	float x;
-	float y;
-} Point;
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define TRUE 1
 #define FALSE 0
@@ -29,18 +29,114 @@ typedef struct{
 #define BLOCK_HIGH(id, p, n) (BLOCK_LOW((id)+1, p, n) - 1)
 #define BLOCK_SIZE(id, p, n) (BLOCK_LOW((id)+1, p, n) - BLOCK_LOW(id, p, n))
 
+/* rounds of k-means|| and the candidates drawn per round, times k */
+#define PARALLEL_ROUNDS 5
+#define OVERSAMPLING 2
+
+/* most bytes of one read or write, a count is an int */
+#define IO_PIECE (1 << 30)
+/* most bytes of the line of a label, the digits of an int and the newline */
+#define LABEL_WIDTH 12
+/* bytes read at a time past the share of a process to finish its last line */
+#define TEXT_STEP 65536
+
+/* the slowest process may take this many times the mean before points move */
+#define BALANCE_SLACK 1.05
+
+/* the checkpoint of the iterations, written by root, and its magic */
+#define CHECKPOINT_FILE "checkpoint.bin"
+#define CHECKPOINT_MAGIC "KMCKPT1"
+
+/* doubles packed per pass: k rows of sums, k counts, the inertia, the labels changed and the time */
+#define PACKED_SIZE(k, dim) ((size_t) (k) * ((dim) + 1) + 3)
+
+struct Convergence;	/* see convergence.h */
+
+/*
+ * The state of the iterations saved in a checkpoint, followed by the k
+ * centroids
+ */
+typedef struct Checkpoint{
+	char magic[8];	/* CHECKPOINT_MAGIC */
+	int k;	/* number of clusters */
+	int dim;	/* number of dimensions */
+	int size;	/* number of points */
+	int loops;	/* iterations done */
+	int full;	/* iterations summing all the points */
+	double seconds;	/* seconds of the iterations */
+	double lastInertia;	/* inertia of the last iteration, negative if not tracked */
+} Checkpoint;
+
+/*
+ * A checkpoint being written behind the iterations, to a temporary file
+ * renamed once complete
+ */
+typedef struct Snapshot{
+	MPI_File fh;
+	MPI_Request request;
+	char *buffer;	/* the checkpoint and the centroids */
+	int pending;	/* whether a write is running */
+} Snapshot;
+
+/*
+ * The processes of one node, adding up their passes through the memory
+ * they share before one of them takes part in the reduction between nodes
+ */
+typedef struct Node{
+	MPI_Comm local;	/* the processes of this node */
+	MPI_Comm leaders;	/* the first process of each node, MPI_COMM_NULL on the others */
+	MPI_Win window;	/* the memory shared on the node, held by its leader */
+	int rank;	/* rank of this process on the node */
+	int size;	/* number of processes on the node */
+	size_t packedSize;	/* doubles of a packed pass */
+	double *slots;	/* the packed pass of each process of the node */
+	double *totals;	/* the packed pass of all processes */
+	double *shift;	/* how far the centroid moving the most moved */
+	float *centroids;	/* the one copy of the centroids on the node */
+} Node;
+
 void help();
 
-void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, char ** centFileName);
+void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, unsigned *seed, char ** centFileName, int *a, int *kernel, int *g, int *delta, int *pipeline, int *threads, int *balance, int *period, int *resume, struct Convergence *stop);
+
+float *readCentroids(char *fileName, int count, int dim);
+
+void printPoint(FILE *pWrite, float *point, int dim);
+
+void printIteration(struct Convergence *c);
+
+float *initialCentroids(float *data, int *offsets, int dim, int k, int r, int id, int p);
+
+float *readPartition(char *fileName, int id, int p, int *offsets, int *dim);
+
+void writeToFile(int *labels, int chunkSize, int n, float *centroids, int k, int dim, int id);
+
+void packPass(float *sums, int *counts, int k, int dim, double inertia, long changed, double elapsed, double *packed);
+
+double unpackCentroids(double *packed, float *centroids, int k, int dim);
+
+void createNode(Node *node, int k, int dim);
+
+double *reduceNode(Node *node);
+
+double nodeCentroids(Node *node, double *totals, int k, int dim);
+
+void freeNode(Node *node);
+
+double updateWeights(float *data, int chunkSize, int dim, float *candidates, int from, int to, double *weights);
+
+float *parallelCentroids(float *data, int *offsets, int dim, int k, int kernel, int generic, int id, int p, MPI_Datatype MPI_POINT);
+
+struct KMeans;	/* see libkmeans.h */
 
-Point *readData(char *fileName, int *count);
+void startCheckpoint(Snapshot *s, Checkpoint *c, float *centroids);
 
-Point *readCentroids(char *fileName, int count);
+void finishCheckpoint(Snapshot *s, int wait);
 
-Point *initialCentroids(Point *data, int size, int k, int r);
+float *readCheckpoint(Checkpoint *c, int k, int dim, int size);
 
-void writeToFile(int *labels, int n, Point *centroids, int k);
+float *balancePoints(float *data, int *offsets, double seconds, struct KMeans *km, int id, int p, MPI_Datatype MPI_POINT);
 
-void sumPoint(void *in, void *inout, int *len, MPI_Datatype *dptr);
+long pipelinedPass(struct KMeans *km, float *data, int chunkSize, int blocks, double elapsed, double *packed, double *hidden, double *exposed);
 
 #endif /* KMEANS_H_ */
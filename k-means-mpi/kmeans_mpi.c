@@ -6,6 +6,9 @@
  */
 
 #include "kmeans.h"
+#include "libkmeans.h"
+#include "loader.h"
+#include "seeding.h"
 
 /*
  * Print the usage of this programme
@@ -15,7 +18,24 @@ void help(){
 	printf("<-i inputFileName>	:	input data file path and name\n");
 	printf("[-k k-means]		:	the number of k, should be larger than 0, default 9\n");
 	printf("[-r]			:	whether create centroids randomly\n");
+	printf("[-P]			:	create the centroids with k-means|| across the processes\n");
+	printf("[-S seed]		:	seed of the random numbers, default the time\n");
 	printf("[-c centroidFileName]	:	the starting centroids file\n");
+	printf("[-n loops]		:	most iterations, default no limit\n");
+	printf("[-t seconds]		:	time budget of the iterations, default none\n");
+	printf("[-x shift]		:	stop once no centroid moves further than this, default 0\n");
+	printf("[-e fraction]		:	stop once the inertia changes by less than this fraction\n");
+	printf("[-l fraction]		:	stop once fewer than this fraction of the labels change\n");
+	printf("[-v]			:	print the statistics of every iteration\n");
+	printf("[-d period]		:	update the sums by the points changing cluster, re-summing all every period iterations\n");
+	printf("[-o blocks]		:	overlap the reductions with the assignment, in this many blocks per process\n");
+	printf("[-b loops]		:	move points from slow to fast processes after this many iterations\n");
+	printf("[-w period]		:	write a checkpoint every period iterations into %s\n", CHECKPOINT_FILE);
+	printf("[-R]			:	resume the iterations from %s\n", CHECKPOINT_FILE);
+	printf("[-p threads]		:	threads per process when built with OpenMP, default OMP_NUM_THREADS\n");
+	printf("[-a]			:	skip distance computations with triangle inequality bounds\n");
+	printf("[-K kernel]		:	assignment kernel: scalar, sse4, avx2 or avx512, default the best supported\n");
+	printf("[-g]			:	use the generic assignment kernel for every dimension\n");
 	printf("[-h]			:	print this help\n");
 }
 
@@ -28,16 +48,27 @@ void help(){
  * @param argv			char**	list of arguments
  * @param inputFileName	char**	input file path and name
  * @param k				int*	k-means
- * @param r				int*	whether create centroids randomly
+ * @param r				int*	how to create the centroids, INIT_CHUNKS, INIT_RANDOM or INIT_PLUSPLUS
+ * @param seed			unsigned*	seed of the random numbers
  * @param centFileName		char**	the starting centroids file
+ * @param a				int*	whether skip distance computations with bounds
+ * @param kernel			int*	the assignment kernel requested
+ * @param g				int*	whether use the generic assignment kernel
+ * @param delta			int*	iterations between full sums of the delta updates, 0 for no delta updates
+ * @param pipeline		int*	blocks per process of the overlapped reductions, 0 for blocking reductions
+ * @param threads		int*	threads per process, 0 for the default of OpenMP
+ * @param balance		int*	iterations timed before balancing the points, 0 for no balancing
+ * @param period		int*	iterations between checkpoints, 0 for none
+ * @param resume		int*	whether resume from the checkpoint
+ * @param stop			Convergence*	the rules ending the iterations
  *
  * @return void
  */
-void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, char **centFileName){
+void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, unsigned *seed, char **centFileName, int *a, int *kernel, int *g, int *delta, int *pipeline, int *threads, int *balance, int *period, int *resume, Convergence *stop){
 	int c;
 	opterr = 0;
 
-	while((c = getopt(argc, argv, "i:k:c:hr")) != -1){
+	while((c = getopt(argc, argv, "i:k:c:n:t:x:e:l:d:o:p:b:w:S:hrRPaK:gv")) != -1){
 		switch(c){
 			case 'i':
 				*inputFileName = (char *)malloc(strlen(optarg) * sizeof(optarg));
@@ -47,12 +78,65 @@ void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r,
 				*k = atoi(optarg);
 				break;
 			case 'r':
-				*r = TRUE;
+				*r = INIT_RANDOM;
+				break;
+			case 'P':
+				*r = INIT_PLUSPLUS;
+				break;
+			case 'S':
+				*seed = (unsigned) strtoul(optarg, NULL, 10);
+				break;
+			case 'a':
+				*a = TRUE;
+				break;
+			case 'K':
+				if((*kernel = kernelByName(optarg)) == KERNEL_AUTO){
+					printf("Unknown kernel: %s\n", optarg);
+				}
+				break;
+			case 'g':
+				*g = TRUE;
 				break;
 			case 'c':
 				*centFileName = (char *)malloc(strlen(optarg) * sizeof(optarg));
 				strcpy(*centFileName, optarg);
 				break;
+			case 'n':
+				stop->loops = atoi(optarg);
+				break;
+			case 't':
+				stop->seconds = atof(optarg);
+				break;
+			case 'x':
+				stop->shift = atof(optarg);
+				break;
+			case 'e':
+				stop->inertia = atof(optarg);
+				break;
+			case 'l':
+				stop->changed = atof(optarg);
+				break;
+			case 'd':
+				*delta = atoi(optarg);
+				break;
+			case 'o':
+				*pipeline = atoi(optarg);
+				break;
+			case 'p':
+				*threads = atoi(optarg);
+				break;
+			case 'b':
+				*balance = atoi(optarg);
+				break;
+			case 'w':
+				*period = atoi(optarg);
+				break;
+			case 'R':
+				*resume = TRUE;
+				break;
+			case 'v':
+				stop->verbose = TRUE;
+				break;
 			case 'h':
 				help();
 				MPI_Finalize();
@@ -75,32 +159,29 @@ void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r,
 }
 
 /*
- * Reads the data points from input file
+ * Reads the centroids from input file
  *
  * This function will change the value of count
  *
- * @param fileName	char*			the file path and name to be read
- * @param count		int*			number of file lines
+ * @param fileName	char*	the file path and name to be read
+ * @param count		int	number of file lines
+ * @param dim		int	number of dimensions
  *
- * @return data		Point*	array storing the points
+ * @return data		float*	the centroids, one row of dim values each
  *
  */
-Point *readData(char *fileName, int *count){
+float *readCentroids(char *fileName, int count, int dim){
 	FILE *pRead;
-	Point *data = (Point *) malloc(sizeof(Point));
-	float nX, nY;
+	float *data = (float *) calloc((size_t) count * dim, sizeof(float));
+	int i;
 
 	if((pRead = fopen(fileName, "r")) == NULL){
 		printf("Fail to open file: %s", fileName);
 		exit(-1);
 	}
 
-	*count = 0;
-	while(fscanf(pRead, "%f %f\n", &nX, &nY) != EOF){
-		data = (Point *) realloc(data, (*count+1) * sizeof(Point));
-		data[*count].x = nX;
-		data[*count].y = nY;
-		++ *count;
+	for(i = 0; i < count * dim; i++){
+		fscanf(pRead, "%f", &data[i]);
 	}
 	fclose(pRead);
 
@@ -108,63 +189,120 @@ Point *readData(char *fileName, int *count){
 }
 
 /*
- * Reads the centroids from input file
- *
- * This function will change the value of count
- *
- * @param fileName	char*	the file path and name to be read
- * @param count		int	number of file lines
+ * Print a point as one line of dim values
  *
- * @return data		Point*	array storing the points
+ * @param pWrite	FILE*	the file to write to
+ * @param point		float*	the dim values of the point
+ * @param dim		int		number of dimensions
  *
+ * @return void
  */
-Point *readCentroids(char *fileName, int count){
-	FILE *pRead;
-	Point *data = (Point *) calloc(count, sizeof(Point));
-	int i;
+void printPoint(FILE *pWrite, float *point, int dim){
+	int t;
 
-	if((pRead = fopen(fileName, "r")) == NULL){
-		printf("Fail to open file: %s", fileName);
-		exit(-1);
+	for(t = 0; t < dim; t++){
+		fprintf(pWrite, t ? " %f" : "%f", point[t]);
 	}
+	fprintf(pWrite, "\n");
+}
 
-	for(i = 0; i < count; i++){
-		fscanf(pRead, "%f %f\n", &data[i].x, &data[i].y);
-	}
-	fclose(pRead);
+/*
+ * Print the measures of the last iteration, kept by the rules
+ *
+ * @param c		Convergence*	the rules, after the iteration was checked
+ *
+ * @return void
+ */
+void printIteration(Convergence *c){
+	printf("Loop %d: largest shift %.6g, inertia %.6g, %ld labels changed, %.3f s.\n",
+			c->lastLoop, c->lastShift, c->lastInertia, c->lastChanged, c->lastElapsed);
+}
 
-	return data;
+/*
+ * Write some bytes of a file with MPI-IO, every process at its own
+ * offset, collectively and in pieces a count of int can hold
+ *
+ * @param fh		MPI_File	the open file
+ * @param offset	MPI_Offset	where to start
+ * @param buffer	char*		the bytes
+ * @param length	size_t		number of bytes
+ *
+ * @return void
+ */
+static void writeBytes(MPI_File fh, MPI_Offset offset, char *buffer, size_t length){
+	MPI_Datatype piece;
+	size_t pieces = length / IO_PIECE;
+
+	MPI_Type_contiguous(IO_PIECE, MPI_BYTE, &piece);
+	MPI_Type_commit(&piece);
+	MPI_File_write_at_all(fh, offset, buffer, (int) pieces, piece, MPI_STATUS_IGNORE);
+	MPI_File_write_at_all(fh, offset + pieces * IO_PIECE, buffer + pieces * IO_PIECE, (int) (length % IO_PIECE), MPI_BYTE, MPI_STATUS_IGNORE);
+	MPI_Type_free(&piece);
 }
 
 /*
- * writes the labels and centroids into corresponding files
+ * writes the labels and centroids into corresponding files, every
+ * process writing the lines of its own labels at their place in the
+ * file with MPI-IO, the root the centroids
  *
- * @param labels	int*	The array storing cluster labels for each point
+ * @param labels	int*	The array storing cluster labels for each local point
+ * @param chunkSize	int		number of local points
  * @param size		int		The size of data
- * @param centroids	Point*	The array storing k centroids
+ * @param centroids	float*	The k centroids, one row of dim values each
  * @param k			int		k-means
+ * @param dim		int		number of dimensions
+ * @param id		int		id of this process
  *
  * @return void
  */
-void writeToFile(int *labels, int size, Point *centroids, int k){
+void writeToFile(int *labels, int chunkSize, int size, float *centroids, int k, int dim, int id){
 	char *outLabelFileName = "labels.txt";
 	char *outCntrdFileName = "centroids.txt";
 	FILE *pWrite;
-	int i;
+	MPI_File fh;
+	long long length, offset = 0;
+	char *text = (char *) malloc((size_t) chunkSize * LABEL_WIDTH + 1), *end, digits[LABEL_WIDTH];
+	int i, n, label;
+	double seconds = - MPI_Wtime();
+
+	/* print the labels of this process */
+	end = text;
+	for(i = 0; i < chunkSize; i++){
+		label = labels[i];
+		n = 0;
+		do{
+			digits[n++] = '0' + label % 10;
+			label /= 10;
+		}while(label > 0);
+		while(n > 0){
+			*end++ = digits[--n];
+		}
+		*end++ = '\n';
+	}
+	length = end - text;
+
+	/* the text of each process follows those of the processes before */
+	MPI_Exscan(&length, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+	if(id == ROOT){
+		offset = 0;
+	}
 
 	/* write labels into file */
-	if((pWrite = fopen(outLabelFileName, "w")) == NULL){
+	if(MPI_File_open(MPI_COMM_WORLD, outLabelFileName, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh) != MPI_SUCCESS){
 		printf("Fail to open output file: %s\n", outLabelFileName);
 		exit(-1);
 	}
+	MPI_File_set_size(fh, 0);
+	writeBytes(fh, offset, text, length);
+	MPI_File_close(&fh);
+	free(text);
 
-	for(i = 0; i < size; i++){
-		fprintf(pWrite, "%d\n", labels[i]);
+	seconds += MPI_Wtime();
+	if(id != ROOT){
+		return;
 	}
 
-	fclose(pWrite);
-
-	printf("Successfully wrote %d labels into file: %s\n", size, outLabelFileName);
+	printf("Successfully wrote %d labels into file: %s in %.3f s\n", size, outLabelFileName, seconds);
 
 	/* write centroids into file */
 	if((pWrite = fopen(outCntrdFileName, "w")) == NULL){
@@ -173,7 +311,7 @@ void writeToFile(int *labels, int size, Point *centroids, int k){
 	}
 
 	for(i = 0; i < k; i++){
-		fprintf(pWrite, "%f %f\n", centroids[i].x, centroids[i].y);
+		printPoint(pWrite, centroids + (size_t) i * dim, dim);
 	}
 
 	fclose(pWrite);
@@ -182,19 +320,26 @@ void writeToFile(int *labels, int size, Point *centroids, int k){
 }
 
 /*
- * Initialize the centroids, randomly select initial points
+ * Initialize the centroids from the points of all processes, from the
+ * first point of k chunks of the data or at random coordinates within
+ * the range of the data, the root drawing them
  *
- * @param data	Point*	array of input points
- * @param size	int		number of points
- * @param k		int		number of clusters
- * @param r		int		whether create randomly
+ * @param data		float*	the local points, one row of dim values per point
+ * @param offsets	int*	index of the first point of each process, and the number of points last
+ * @param dim		int		number of dimensions
+ * @param k			int		number of clusters
+ * @param r			int		how to create them, INIT_CHUNKS or INIT_RANDOM
+ * @param id		int		id of this process
+ * @param p			int		number of processes
  *
- * @return Point* array of centroids
+ * @return float* the k centroids on the root, one row of dim values each
  *
  */
-Point *initialCentroids(Point *data, int size, int k, int r){
-	Point *c = (Point *) calloc(k, sizeof(Point));
-	int i,j;
+float *initialCentroids(float *data, int *offsets, int dim, int k, int r, int id, int p){
+	float *c = (float *) calloc((size_t) k * dim, sizeof(float));
+	float *local = (float *) calloc((size_t) k * dim, sizeof(float));
+	float *bounds = (float *) malloc(2 * dim * sizeof(float));	/* the lowest and the highest values */
+	int i, j, t, size = offsets[p], chunkSize = offsets[id + 1] - offsets[id];
 	char *fileName = "initial.txt";
 	FILE *pWrite;
 
@@ -202,20 +347,42 @@ Point *initialCentroids(Point *data, int size, int k, int r){
 		k = size;
 	}
 
-	srand((unsigned) time(NULL));
-	for(i = j = 0; i < k; i++){
-		if(r){
-			c[i].x = (float) (rand() % 1000) / 1000 * 8;
-			c[i].y = (float) (rand() % 1000) / 1000 * 8;
- 		}else{
- 			/*
+	if(r == INIT_RANDOM){
+		/* the range of the data is all the root needs */
+		for(t = 0; t < dim; t++){
+			bounds[t] = FLT_MAX;
+			bounds[dim + t] = -FLT_MAX;
+		}
+		for(i = 0; i < chunkSize; i++){
+			for(t = 0; t < dim; t++){
+				bounds[t] = fminf(bounds[t], data[(size_t) i * dim + t]);
+				bounds[dim + t] = fmaxf(bounds[dim + t], data[(size_t) i * dim + t]);
+			}
+		}
+		MPI_Allreduce(MPI_IN_PLACE, bounds, dim, MPI_FLOAT, MPI_MIN, MPI_COMM_WORLD);
+		MPI_Allreduce(MPI_IN_PLACE, bounds + dim, dim, MPI_FLOAT, MPI_MAX, MPI_COMM_WORLD);
+		if(id == ROOT){
+			randomCentroids(bounds, 2, dim, k, c);
+		}
+	}else{
+		for(i = j = 0; i < k; i++){
+			/*
 			 * pick the first point from k chunks,
 			 * it's not real random, but acceptable
 			 */
+			if(j >= offsets[id] && j < offsets[id + 1]){
+				memcpy(local + (size_t) i * dim, data + (size_t) (j - offsets[id]) * dim, dim * sizeof(float));
+			}
 			j += size/k;
-			c[i].x = data[j].x;
-			c[i].y = data[j].y;
- 		}
+		}
+		/* each point comes from one process, the others add zeros */
+		MPI_Reduce(local, c, k * dim, MPI_FLOAT, MPI_SUM, ROOT, MPI_COMM_WORLD);
+	}
+
+	free(local);
+	free(bounds);
+	if(id != ROOT){
+		return c;
 	}
 
 	/* write to file */
@@ -225,7 +392,7 @@ Point *initialCentroids(Point *data, int size, int k, int r){
 	}
 
 	for(i = 0; i < k; i++){
-		fprintf(pWrite, "%f %f\n", c[i].x, c[i].y);
+		printPoint(pWrite, c + (size_t) i * dim, dim);
 	}
 
 	printf("Successfully wrote initial centroids into file: %s\n", fileName);
@@ -236,22 +403,866 @@ Point *initialCentroids(Point *data, int size, int k, int r){
 }
 
 /*
- * Sum the points, used in MPI_Reduce
+ * Read some bytes of a file with MPI-IO, in pieces a count of int can hold
+ *
+ * This function will change the value of buffer
+ *
+ * @param fh		MPI_File	the open file
+ * @param offset	MPI_Offset	where to start
+ * @param buffer	char*		where to put the bytes
+ * @param length	size_t		number of bytes
+ *
+ * @return void
  */
-void sumPoint(void *in, void *inout, int *len, MPI_Datatype *dptr){
-	int i;
-	Point *p1 = (Point *) in;
-	Point *p2 = (Point *) inout;
-	Point *p = p2;
+static void readBytes(MPI_File fh, MPI_Offset offset, char *buffer, size_t length){
+	size_t piece;
+
+	while(length > 0){
+		piece = length < IO_PIECE ? length : IO_PIECE;
+		MPI_File_read_at(fh, offset, buffer, (int) piece, MPI_BYTE, MPI_STATUS_IGNORE);
+		offset += piece;
+		buffer += piece;
+		length -= piece;
+	}
+}
+
+/*
+ * Read an even share of the points of a binary file, see BinaryHeader,
+ * rows at once and columns one by one
+ *
+ * This function will change the value of chunkSize and dim
+ *
+ * @param fileName	char*		the file path and name, for the messages
+ * @param fh		MPI_File	the open file
+ * @param h			BinaryHeader*	the header of the file
+ * @param length	MPI_Offset	the length of the file
+ * @param id		int			id of this process
+ * @param p			int			number of processes
+ * @param chunkSize	int*		number of points read
+ * @param dim		int*		number of dimensions
+ *
+ * @return float*	the points, one row of dim values per point
+ */
+static float *readBinaryPart(char *fileName, MPI_File fh, BinaryHeader *h, MPI_Offset length, int id, int p, int *chunkSize, int *dim){
+	MPI_Datatype point;
+	MPI_Offset first;
+	float *data, *column;
+	int i, t;
+
+	if(h->dtype != BINARY_FLOAT32 || (h->layout != LAYOUT_ROWS && h->layout != LAYOUT_COLUMNS)){
+		printf("Unsupported binary file: %s\n", fileName);
+		exit(-1);
+	}
+	if(h->count == 0 || h->dim == 0 || h->count > INT_MAX || h->dim > INT_MAX
+			|| (uint64_t) (length - BINARY_HEADER) / sizeof(float) / h->dim < h->count){
+		printf("No data in file: %s\n", fileName);
+		exit(-1);
+	}
+	*dim = h->dim;
+	first = BLOCK_LOW(id, p, (MPI_Offset) h->count);
+	*chunkSize = BLOCK_SIZE(id, p, (MPI_Offset) h->count);
+	data = (float *) malloc((size_t) *chunkSize * *dim * sizeof(float) + 1);
+
+	if(h->layout == LAYOUT_ROWS){
+		MPI_Type_contiguous(*dim, MPI_FLOAT, &point);
+		MPI_Type_commit(&point);
+		MPI_File_read_at_all(fh, BINARY_HEADER + first * *dim * sizeof(float), data, *chunkSize, point, MPI_STATUS_IGNORE);
+		MPI_Type_free(&point);
+	}else{
+		column = (float *) malloc((size_t) *chunkSize * sizeof(float) + 1);
+		for(t = 0; t < *dim; t++){
+			MPI_File_read_at_all(fh, BINARY_HEADER + ((MPI_Offset) t * h->count + first) * sizeof(float), column, *chunkSize, MPI_FLOAT, MPI_STATUS_IGNORE);
+			for(i = 0; i < *chunkSize; i++){
+				data[(size_t) i * *dim + t] = column[i];
+			}
+		}
+		free(column);
+	}
+
+	return data;
+}
+
+/*
+ * Read the lines of a text file starting in an even share of its bytes,
+ * the last one read on past the share up to its end
+ *
+ * This function will change the value of chunkSize and dim
+ *
+ * @param fh		MPI_File	the open file
+ * @param length	MPI_Offset	the length of the file
+ * @param id		int			id of this process
+ * @param p			int			number of processes
+ * @param chunkSize	int*		number of points read
+ * @param dim		int*		number of dimensions, from the first line of the file
+ *
+ * @return float*	the points, one row of dim values per point
+ */
+static float *readTextPart(MPI_File fh, MPI_Offset length, int id, int p, int *chunkSize, int *dim){
+	MPI_Offset from = BLOCK_LOW(id, p, length), to = BLOCK_LOW(id + 1, p, length);
+	MPI_Offset begin = from > 0 ? from - 1 : 0;	/* the byte before tells whether a line starts at from */
+	size_t size = to - begin, end = size, skip = 0, more;
+	char *text = (char *) malloc(size + 1), *first, *eol;
+	float *data;
+
+	readBytes(fh, begin, text, size);
+
+	/* skip the rest of a line started before */
+	if(from > 0){
+		skip = (eol = (char *) memchr(text, '\n', size)) == NULL ? size : (size_t) (eol + 1 - text);
+	}
+
+	/* finish the last line started here */
+	if(skip < size){
+		while(text[end - 1] != '\n' && begin + (MPI_Offset) end < length){
+			more = length - (begin + end) < TEXT_STEP ? length - (begin + end) : TEXT_STEP;
+			text = (char *) realloc(text, end + more);
+			readBytes(fh, begin + end, text + end, more);
+			if((eol = (char *) memchr(text + end, '\n', more)) != NULL){
+				more = eol + 1 - (text + end);
+			}
+			end += more;
+		}
+	}
+
+	/* the dimension comes from the first line of the file which is not blank */
+	if(id == ROOT){
+		first = skipBlankLines(text, text + end);
+		if((eol = (char *) memchr(first, '\n', text + end - first)) == NULL){
+			eol = text + end;
+		}
+		*dim = countDimensions(first, eol);
+	}
+	MPI_Bcast(dim, 1, MPI_INT, ROOT, MPI_COMM_WORLD);
+	if(*dim == 0){
+		if(id == ROOT){
+			printf("No data in the input file\n");
+		}
+		exit(-1);
+	}
+
+	data = skip < size ? parseText(text + skip, text + end, *dim, chunkSize) : NULL;
+	if(data == NULL){
+		if(skip < size && *chunkSize < 0){
+			printf("Process %d can not allocate its points\n", id);
+			exit(-1);
+		}
+		*chunkSize = 0;
+	}
+	free(text);
+
+	return data;
+}
+
+/*
+ * Read the points of this process from the input file, every process
+ * reading its own part with MPI-IO: an even share of the points of a
+ * binary file, or the lines starting in an even share of the bytes of
+ * a text file
+ *
+ * This function will change the value of offsets and dim
+ *
+ * @param fileName	char*	the file path and name to be read
+ * @param id		int		id of this process
+ * @param p			int		number of processes
+ * @param offsets	int*	index of the first point of each process, and the number of points last
+ * @param dim		int*	number of dimensions
+ *
+ * @return float*	the local points, one row of dim values per point
+ */
+float *readPartition(char *fileName, int id, int p, int *offsets, int *dim){
+	MPI_File fh;
+	MPI_Offset length;
+	BinaryHeader h;
+	float *data;
+	int i, chunkSize;
+	double seconds = - MPI_Wtime();
+
+	if(MPI_File_open(MPI_COMM_WORLD, fileName, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS){
+		printf("Fail to open file: %s\n", fileName);
+		exit(-1);
+	}
+	MPI_File_get_size(fh, &length);
+	if(length == 0){
+		printf("No data in file: %s\n", fileName);
+		exit(-1);
+	}
+
+	memset(&h, 0, sizeof(BinaryHeader));
+	if(length >= BINARY_HEADER){
+		MPI_File_read_at_all(fh, 0, &h, BINARY_HEADER, MPI_BYTE, MPI_STATUS_IGNORE);
+	}
+	if(length >= BINARY_HEADER && memcmp(h.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0){
+		data = readBinaryPart(fileName, fh, &h, length, id, p, &chunkSize, dim);
+	}else{
+		data = readTextPart(fh, length, id, p, &chunkSize, dim);
+	}
+	MPI_File_close(&fh);
+
+	/* place the points of each process */
+	MPI_Allgather(&chunkSize, 1, MPI_INT, offsets + 1, 1, MPI_INT, MPI_COMM_WORLD);
+	offsets[0] = 0;
+	for(i = 1; i <= p; i++){
+		offsets[i] += offsets[i - 1];
+	}
+
+	seconds += MPI_Wtime();
+	if(id == ROOT){
+		printf("Read %d points in %.3f s, by %d processes.\n", offsets[p], seconds, p);
+	}
+
+	return data;
+}
+
+/*
+ * Pack what a process found in a pass into one buffer of doubles, so a
+ * single MPI_Allreduce with MPI_SUM adds up the passes of all processes:
+ * the sums, then the counts, then the measures, see PACKED_SIZE
+ *
+ * This function will change the value of packed
+ *
+ * @param sums		float*	the sums of each cluster, one row of dim values each
+ * @param counts	int*	the number of points of each cluster
+ * @param k			int		number of clusters
+ * @param dim		int		number of dimensions
+ * @param inertia	double	sum of the squared distances of the points to their centroids
+ * @param changed	long	number of labels changed
+ * @param elapsed	double	seconds since the iterations started, from one process only
+ * @param packed	double*	the buffer, PACKED_SIZE(k, dim) values
+ *
+ * @return void
+ */
+void packPass(float *sums, int *counts, int k, int dim, double inertia, long changed, double elapsed, double *packed){
+	size_t i, n = (size_t) k * dim;
+
+	for(i = 0; i < n; i++){
+		packed[i] = sums[i];
+	}
+	for(i = 0; i < (size_t) k; i++){
+		packed[n + i] = counts[i];
+	}
+	packed[n + k] = inertia;
+	packed[n + k + 1] = changed;
+	packed[n + k + 2] = elapsed;
+}
+
+/*
+ * Move each centroid to the mean of its cluster, from the packed sums and
+ * counts of all processes
+ *
+ * This function will change the value of centroids
+ *
+ * @param packed	double*	the buffer, see packPass
+ * @param centroids	float*	the k centroids, one row of dim values each
+ * @param k			int		number of clusters
+ * @param dim		int		number of dimensions
+ *
+ * @return double	how far the centroid moving the most moved
+ */
+double unpackCentroids(double *packed, float *centroids, int k, int dim){
+	int i, t;
+	float temp, *centroid;
+	double *sum, count, diff, shift, maxShift = 0;
+
+	for(i = 0; i < k; i++){
+		sum = packed + (size_t) i * dim;
+		count = packed[(size_t) k * dim + i];
+		centroid = centroids + (size_t) i * dim;
+		shift = 0;
+		for(t = 0; t < dim; t++){
+			temp = count ? (float) (sum[t] / count) : 0;
+			diff = (double) temp - centroid[t];
+			shift += diff * diff;
+			centroid[t] = temp;
+		}
+		if(shift > maxShift){
+			maxShift = shift;
+		}
+	}
+
+	return sqrt(maxShift);
+}
+
+/*
+ * Split the processes by the nodes sharing memory, and allocate the
+ * packed pass of each process, the totals and the centroids in a window
+ * of the node. The leader of a node is the process of the lowest rank,
+ * so root leads its node.
+ *
+ * This function will change the value of node
+ *
+ * @param node	Node*	the node to set up
+ * @param k		int		number of clusters
+ * @param dim	int		number of dimensions
+ *
+ * @return void
+ */
+void createNode(Node *node, int k, int dim){
+	MPI_Aint bytes;
+	int unit, id;
+	char *base;
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &id);
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, id, MPI_INFO_NULL, &node->local);
+	MPI_Comm_rank(node->local, &node->rank);
+	MPI_Comm_size(node->local, &node->size);
+	MPI_Comm_split(MPI_COMM_WORLD, node->rank == 0 ? 0 : MPI_UNDEFINED, id, &node->leaders);
+
+	/* the leader holds it all, the others find it through the leader */
+	node->packedSize = PACKED_SIZE(k, dim);
+	bytes = node->rank == 0 ? ((node->size + 1) * node->packedSize + 1) * sizeof(double) + (size_t) k * dim * sizeof(float) : 0;
+	MPI_Win_allocate_shared(bytes, 1, MPI_INFO_NULL, node->local, &base, &node->window);
+	MPI_Win_shared_query(node->window, 0, &bytes, &unit, &base);
+	node->slots = (double *) base;
+	node->totals = node->slots + node->size * node->packedSize;
+	node->shift = node->totals + node->packedSize;
+	node->centroids = (float *) (node->shift + 1);
+
+	/* the processes of the node write and read the window between barriers */
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, node->window);
+}
+
+/*
+ * Make the writes to the window of the node seen by all its processes
+ *
+ * @param node	Node*	the node
+ *
+ * @return void
+ */
+static void syncNode(Node *node){
+	MPI_Win_sync(node->window);
+	MPI_Barrier(node->local);
+	MPI_Win_sync(node->window);
+}
+
+/*
+ * Add up the packed passes of all processes, each one in its slot of the
+ * window of its node. The processes of a node each add up a share of the
+ * slots, then the leaders add up the totals of the nodes with one
+ * MPI_Allreduce, so only one process per node takes part.
+ *
+ * This function will change the value of the totals of the node
+ *
+ * @param node	Node*	the node
+ *
+ * @return double*	the totals, in the window, for every process of the node
+ */
+double *reduceNode(Node *node){
+	size_t t, from, to;
+	int j;
+
+	syncNode(node);
+	from = BLOCK_LOW(node->rank, node->size, node->packedSize);
+	to = BLOCK_LOW(node->rank + 1, node->size, node->packedSize);
+	for(t = from; t < to; t++){
+		node->totals[t] = node->slots[t];
+		for(j = 1; j < node->size; j++){
+			node->totals[t] += node->slots[j * node->packedSize + t];
+		}
+	}
+	syncNode(node);
+
+	if(node->leaders != MPI_COMM_NULL){
+		MPI_Allreduce(MPI_IN_PLACE, node->totals, node->packedSize, MPI_DOUBLE, MPI_SUM, node->leaders);
+	}
+	syncNode(node);
+
+	return node->totals;
+}
+
+/*
+ * Move the centroids of the node to the means of their clusters, done by
+ * the leader alone while the others wait
+ *
+ * This function will change the value of the centroids of the node
+ *
+ * @param node		Node*	the node
+ * @param totals	double*	the packed pass of all processes, see packPass
+ * @param k			int		number of clusters
+ * @param dim		int		number of dimensions
+ *
+ * @return double	how far the centroid moving the most moved
+ */
+double nodeCentroids(Node *node, double *totals, int k, int dim){
+	if(node->rank == 0){
+		*node->shift = unpackCentroids(totals, node->centroids, k, dim);
+	}
+	syncNode(node);
+
+	return *node->shift;
+}
+
+/*
+ * Free the window and the communicators of the node
+ *
+ * @param node	Node*	the node
+ *
+ * @return void
+ */
+void freeNode(Node *node){
+	MPI_Win_unlock_all(node->window);
+	MPI_Win_free(&node->window);
+	if(node->leaders != MPI_COMM_NULL){
+		MPI_Comm_free(&node->leaders);
+	}
+	MPI_Comm_free(&node->local);
+}
+
+/*
+ * Take the squared distance of each local point to the closest of some
+ * new candidates into account
+ *
+ * This function will change the value of weights
+ *
+ * @param data			float*	the local points, one row of dim values per point
+ * @param chunkSize		int		number of local points
+ * @param dim			int		number of dimensions
+ * @param candidates	float*	the candidates, one row of dim values each
+ * @param from			int		index of the first new candidate
+ * @param to			int		index after the last new candidate
+ * @param weights		double*	squared distance of each local point to the closest candidate
+ *
+ * @return double	the sum of the weights of the local points
+ */
+double updateWeights(float *data, int chunkSize, int dim, float *candidates, int from, int to, double *weights){
+	int i, j;
+	double d, cost = 0;
+
+	for(i = 0; i < chunkSize; i++){
+		for(j = from; j < to; j++){
+			d = squareDistance(data + (size_t) i * dim, candidates + (size_t) j * dim, dim);
+			if(j == 0 || d < weights[i]){
+				weights[i] = d;
+			}
+		}
+		cost += weights[i];
+	}
+
+	return cost;
+}
+
+/*
+ * k-means|| seeding across the processes: starting from one random
+ * point, every round each process draws each of its points with a
+ * probability of OVERSAMPLING * k times its squared distance to the
+ * closest candidate over the total of these distances, and every
+ * process gets the candidates drawn by all. The candidates are weighted
+ * by the number of points closest to them and clustered on the root.
+ * Each process only ever touches its own points, the root handles the
+ * few candidates. The seeding falls back to random centroids when the
+ * candidates can not be clustered.
+ *
+ * @param data		float*	the local points, one row of dim values per point
+ * @param offsets	int*	index of the first point of each process, and the number of points last
+ * @param dim		int		number of dimensions
+ * @param k			int		number of clusters
+ * @param kernel	int		the assignment kernel, one the host supports
+ * @param generic	int		whether use the generic assignment kernel for every dimension
+ * @param id		int		id of this process
+ * @param p			int		number of processes
+ * @param MPI_POINT	MPI_Datatype	a point
+ *
+ * @return float*	the k centroids on the root, one row of dim values each
+ */
+float *parallelCentroids(float *data, int *offsets, int dim, int k, int kernel, int generic, int id, int p, MPI_Datatype MPI_POINT){
+	int chunkSize = offsets[id + 1] - offsets[id];
+	float *c = (float *) calloc((size_t) k * dim, sizeof(float));
+	double *weights = (double *) malloc((size_t) chunkSize * sizeof(double));	/* squared distance to the closest candidate */
+	int *found = (int *) malloc(p * sizeof(int));	/* candidates drawn by each process */
+	int *displs = (int *) malloc(p * sizeof(int));
+	float *candidates = (float *) malloc(dim * sizeof(float));
+	float *drawn = NULL;	/* candidates drawn here this round */
+	int *labels = (int *) malloc((size_t) chunkSize * sizeof(int));
+	long *localWeights, *candidateWeights;
+	float *tile;
+	double cost, localCost;
+	int i, count, drawnCount, total, round, first, owner, seeded = FALSE;
+
+	if(c == NULL || weights == NULL || found == NULL || displs == NULL || candidates == NULL || labels == NULL){
+		printf("Process %d can not allocate the k-means|| seeding\n", id);
+		MPI_Abort(MPI_COMM_WORLD, -1);
+	}
+
+	/* the first candidate is drawn uniformly from all points */
+	if(id == ROOT){
+		first = randomPoint(offsets[p]);
+	}
+	MPI_Bcast(&first, 1, MPI_INT, ROOT, MPI_COMM_WORLD);
+	for(owner = 0; offsets[owner + 1] <= first; owner++);
+	if(id == owner){
+		memcpy(candidates, data + (size_t) (first - offsets[id]) * dim, dim * sizeof(float));
+	}
+	MPI_Bcast(candidates, 1, MPI_POINT, owner, MPI_COMM_WORLD);
+	count = 1;
+	localCost = updateWeights(data, chunkSize, dim, candidates, 0, count, weights);
+
+	for(round = 0; round < PARALLEL_ROUNDS; round++){
+		MPI_Allreduce(&localCost, &cost, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+		if(cost <= 0){
+			break;
+		}
+
+		/* draw the local points */
+		drawnCount = 0;
+		for(i = 0; i < chunkSize; i++){
+			if(randomUnit() * cost < (double) OVERSAMPLING * k * weights[i]){
+				drawn = (float *) realloc(drawn, (size_t) (drawnCount + 1) * dim * sizeof(float));
+				memcpy(drawn + (size_t) drawnCount * dim, data + (size_t) i * dim, dim * sizeof(float));
+				++drawnCount;
+			}
+		}
+
+		/* share the candidates of all processes */
+		MPI_Allgather(&drawnCount, 1, MPI_INT, found, 1, MPI_INT, MPI_COMM_WORLD);
+		for(i = 0, total = 0; i < p; i++){
+			displs[i] = total;
+			total += found[i];
+		}
+		candidates = (float *) realloc(candidates, (size_t) (count + total) * dim * sizeof(float));
+		MPI_Allgatherv(drawn, drawnCount, MPI_POINT, candidates + (size_t) count * dim, found, displs, MPI_POINT, MPI_COMM_WORLD);
+
+		localCost = updateWeights(data, chunkSize, dim, candidates, count, count + total, weights);
+		count += total;
+	}
+
+	/* weight each candidate by the number of points closest to it */
+	tile = createTile(dim);
+	assignWith(kernel, generic, data, dim, 0, chunkSize, candidates, count, labels, tile);
+	free(tile);
+	localWeights = (long *) calloc(count, sizeof(long));
+	candidateWeights = (long *) calloc(count, sizeof(long));
+	for(i = 0; i < chunkSize; i++){
+		++localWeights[labels[i]];
+	}
+	MPI_Reduce(localWeights, candidateWeights, count, MPI_LONG, MPI_SUM, ROOT, MPI_COMM_WORLD);
+
+	if(id == ROOT){
+		printf("k-means|| drew %d candidates in %d rounds.\n", count, round);
+		seeded = reclusterCandidates(candidates, candidateWeights, count, dim, k, kernel, generic, c);
+	}
+	MPI_Bcast(&seeded, 1, MPI_INT, ROOT, MPI_COMM_WORLD);
+
+	/*  Clean up */
+	free(weights);
+	free(found);
+	free(displs);
+	free(candidates);
+	free(drawn);
+	free(labels);
+	free(localWeights);
+	free(candidateWeights);
+
+	if(!seeded){
+		if(id == ROOT){
+			printf("k-means|| could not cluster its candidates, seeding at random.\n");
+		}
+		free(c);
+		c = initialCentroids(data, offsets, dim, k, INIT_RANDOM, id, p);
+	}
+
+	return c;
+}
+
+/*
+ * Start writing a checkpoint behind the iterations, once the one before
+ * is complete. The state and the centroids are copied first, so they may
+ * change while the write runs.
+ *
+ * This function will change the value of s
+ *
+ * @param s			Snapshot*	the checkpoint being written
+ * @param c			Checkpoint*	the state of the iterations
+ * @param centroids	float*	the k centroids, one row of dim values each
+ *
+ * @return void
+ */
+void startCheckpoint(Snapshot *s, Checkpoint *c, float *centroids){
+	size_t bytes = sizeof(Checkpoint) + (size_t) c->k * c->dim * sizeof(float);
+
+	finishCheckpoint(s, TRUE);
+	memcpy(c->magic, CHECKPOINT_MAGIC, sizeof(c->magic));
+	s->buffer = (char *) malloc(bytes);
+	memcpy(s->buffer, c, sizeof(Checkpoint));
+	memcpy(s->buffer + sizeof(Checkpoint), centroids, bytes - sizeof(Checkpoint));
+
+	if(MPI_File_open(MPI_COMM_SELF, CHECKPOINT_FILE ".part", MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &s->fh) != MPI_SUCCESS){
+		printf("Fail to open file: %s\n", CHECKPOINT_FILE ".part");
+		exit(-1);
+	}
+	MPI_File_set_size(s->fh, 0);
+	MPI_File_iwrite_at(s->fh, 0, s->buffer, (int) bytes, MPI_BYTE, &s->request);
+	s->pending = TRUE;
+}
+
+/*
+ * Check whether the checkpoint being written is complete, and if so put
+ * it in place of the last one. A crash while writing leaves the last
+ * complete checkpoint.
+ *
+ * This function will change the value of s
+ *
+ * @param s		Snapshot*	the checkpoint being written
+ * @param wait	int		whether wait for it to complete
+ *
+ * @return void
+ */
+void finishCheckpoint(Snapshot *s, int wait){
+	int flag = TRUE;
+
+	if(!s->pending){
+		return;
+	}
+	if(wait){
+		MPI_Wait(&s->request, MPI_STATUS_IGNORE);
+	}else{
+		MPI_Test(&s->request, &flag, MPI_STATUS_IGNORE);
+	}
+	if(flag){
+		MPI_File_close(&s->fh);
+		if(rename(CHECKPOINT_FILE ".part", CHECKPOINT_FILE) != 0){
+			printf("Fail to write file: %s\n", CHECKPOINT_FILE);
+		}
+		free(s->buffer);
+		s->pending = FALSE;
+	}
+}
+
+/*
+ * Reads the checkpoint of an earlier run on the same data
+ *
+ * This function will change the value of c
+ *
+ * @param c		Checkpoint*	the state of the iterations
+ * @param k		int		number of clusters
+ * @param dim	int		number of dimensions
+ * @param size	int		number of points
+ *
+ * @return float*	the centroids, one row of dim values each
+ */
+float *readCheckpoint(Checkpoint *c, int k, int dim, int size){
+	FILE *pRead;
+	float *centroids = (float *) malloc((size_t) k * dim * sizeof(float));
+
+	if((pRead = fopen(CHECKPOINT_FILE, "rb")) == NULL){
+		printf("Fail to open file: %s\n", CHECKPOINT_FILE);
+		exit(-1);
+	}
+	if(fread(c, sizeof(Checkpoint), 1, pRead) != 1 || memcmp(c->magic, CHECKPOINT_MAGIC, sizeof(c->magic)) != 0){
+		printf("Not a checkpoint: %s\n", CHECKPOINT_FILE);
+		exit(-1);
+	}
+	if(c->k != k || c->dim != dim || c->size != size){
+		printf("The checkpoint holds %d centroids of %d dimensions for %d points, not %d of %d for %d\n", c->k, c->dim, c->size, k, dim, size);
+		exit(-1);
+	}
+	if(fread(centroids, sizeof(float), (size_t) k * dim, pRead) != (size_t) k * dim){
+		printf("The checkpoint is cut short: %s\n", CHECKPOINT_FILE);
+		exit(-1);
+	}
+	fclose(pRead);
+
+	return centroids;
+}
+
+/*
+ * Move the items of each process to the processes getting them, the items
+ * staying in order
+ *
+ * This function will free buffer
+ *
+ * @param buffer	void*	the items of this process
+ * @param offsets	int*	index of the first item of each process, and the number of items last
+ * @param target	int*	the same after the move
+ * @param id		int		id of this process
+ * @param p			int		number of processes
+ * @param type		MPI_Datatype	type of an item
+ *
+ * @return void*	the items of this process after the move
+ */
+static void *migrate(void *buffer, int *offsets, int *target, int id, int p, MPI_Datatype type){
+	int *sendCounts = (int *) malloc(4 * p * sizeof(int));
+	int *sendDispls = sendCounts + p;
+	int *recvCounts = sendDispls + p;
+	int *recvDispls = recvCounts + p;
+	int j, low, high, bytes;
+	void *moved;
+
+	MPI_Type_size(type, &bytes);
+	moved = malloc(((size_t) (target[id + 1] - target[id]) + 1) * bytes);
+	for(j = 0; j < p; j++){
+		/* the items of this process going to process j */
+		low = offsets[id] > target[j] ? offsets[id] : target[j];
+		high = offsets[id + 1] < target[j + 1] ? offsets[id + 1] : target[j + 1];
+		sendCounts[j] = high > low ? high - low : 0;
+		sendDispls[j] = high > low ? low - offsets[id] : 0;
+
+		/* the items of process j coming to this one */
+		low = offsets[j] > target[id] ? offsets[j] : target[id];
+		high = offsets[j + 1] < target[id + 1] ? offsets[j + 1] : target[id + 1];
+		recvCounts[j] = high > low ? high - low : 0;
+		recvDispls[j] = high > low ? low - target[id] : 0;
+	}
+	MPI_Alltoallv(buffer, sendCounts, sendDispls, type, moved, recvCounts, recvDispls, type, MPI_COMM_WORLD);
+
+	free(buffer);
+	free(sendCounts);
+
+	return moved;
+}
+
+/*
+ * Move points between the processes so that each one gets a share in
+ * proportion to its speed over the iterations so far, if the slowest one
+ * took more than BALANCE_SLACK times the mean. The points stay in order
+ * and each process keeps one run of them, so the labels are still written
+ * in the order of the input. Their labels and bounds go along with them.
+ *
+ * This function will change the value of offsets and the workspaces of km
+ *
+ * @param data		float*	the local points, one row of dim values per point
+ * @param offsets	int*	index of the first point of each process, and the number of points last
+ * @param seconds	double	time this process spent assigning its points
+ * @param km		KMeans*	the context, whose labels, labels of the last iteration and bounds follow the points
+ * @param id		int		id of this process
+ * @param p			int		number of processes
+ * @param MPI_POINT	MPI_Datatype	dim floats
+ *
+ * @return float*	the local points after the move
+ */
+float *balancePoints(float *data, int *offsets, double seconds, KMeans *km, int id, int p, MPI_Datatype MPI_POINT){
+	double *times = (double *) malloc(p * sizeof(double));
+	double *speeds = (double *) malloc(p * sizeof(double));
+	int *target = (int *) malloc((p + 1) * sizeof(int));
+	double slowest = 0, mean = 0, known = 0, total = 0, share = 0;
+	int i, count, timed = 0, low, high;
+	long moved = 0;
+
+	MPI_Allgather(&seconds, 1, MPI_DOUBLE, times, 1, MPI_DOUBLE, MPI_COMM_WORLD);
+
+	/* points per second of each process, those with no points or no time get the mean */
+	for(i = 0; i < p; i++){
+		count = offsets[i + 1] - offsets[i];
+		speeds[i] = count > 0 && times[i] > 0 ? count / times[i] : 0;
+		if(speeds[i] > 0){
+			known += speeds[i];
+			++timed;
+		}
+		if(times[i] > slowest){
+			slowest = times[i];
+		}
+		mean += times[i] / p;
+	}
+	for(i = 0; i < p; i++){
+		if(speeds[i] == 0){
+			speeds[i] = timed > 0 ? known / timed : 1;
+		}
+		total += speeds[i];
+	}
+	if(id == ROOT){
+		printf("Before balancing, the slowest process assigned for %.3f s, %.2f times the mean.\n", slowest, mean > 0 ? slowest / mean : 1);
+	}
 
-	for(i = 0; i < *len; i++){
-		p2->x = p1->x + p2->x;
-		p2->y = p1->y + p2->y;
-		p1++;
-		p2++;
+	if(slowest > mean * BALANCE_SLACK){
+		target[0] = 0;
+		for(i = 0; i < p; i++){
+			share += speeds[i] / total * offsets[p];
+			target[i + 1] = i == p - 1 ? offsets[p] : (int) (share + 0.5);
+			/* the points a process gets from the others */
+			low = offsets[i] > target[i] ? offsets[i] : target[i];
+			high = offsets[i + 1] < target[i + 1] ? offsets[i + 1] : target[i + 1];
+			moved += target[i + 1] - target[i] - (high > low ? high - low : 0);
+		}
+
+		data = (float *) migrate(data, offsets, target, id, p, MPI_POINT);
+		km->labels = (int *) migrate(km->labels, offsets, target, id, p, MPI_INT);
+		if(km->previous != NULL){
+			km->previous = (int *) migrate(km->previous, offsets, target, id, p, MPI_INT);
+		}
+		if(km->b != NULL){
+			km->b->upper = (double *) migrate(km->b->upper, offsets, target, id, p, MPI_DOUBLE);
+			km->b->lower = (double *) migrate(km->b->lower, offsets, target, id, p, MPI_DOUBLE);
+		}
+		/* the workspaces now hold exactly the new points */
+		km->capacity = target[id + 1] - target[id];
+		memcpy(offsets, target, (p + 1) * sizeof(int));
+	}
+	if(id == ROOT){
+		printf("Moved %ld points between the processes.\n", moved);
 	}
 
-	inout = p;
+	free(times);
+	free(speeds);
+	free(target);
+
+	return data;
+}
+
+/*
+ * Assign the local points block by block and add up the passes of all
+ * processes, the reduction of each block running while the next blocks
+ * are assigned. The pass is started by the caller.
+ *
+ * This function will change the value of the workspaces of km, packed,
+ * hidden and exposed
+ *
+ * @param km		KMeans*	the context, its pass started
+ * @param data		float*	the local points, one row of dim values per point
+ * @param chunkSize	int		number of local points
+ * @param blocks	int		number of blocks
+ * @param elapsed	double	seconds since the iterations started, from one process only
+ * @param packed	double*	room for blocks buffers of PACKED_SIZE(k, dim), the first gets the totals
+ * @param hidden	double*	seconds with a reduction running behind the assignment
+ * @param exposed	double*	seconds spent waiting for the reductions
+ *
+ * @return long	number of distances computed
+ */
+long pipelinedPass(KMeans *km, float *data, int chunkSize, int blocks, double elapsed, double *packed, double *hidden, double *exposed){
+	int i, j, from, to, flag;
+	int pending = 0;	/* number of reductions running */
+	long evals = 0;
+	size_t t, packedSize = PACKED_SIZE(km->k, km->dim);
+	MPI_Request *requests = (MPI_Request *) malloc(blocks * sizeof(MPI_Request));
+	double since = 0, waitStart;	/* since when reductions are running */
+
+	for(j = 0; j < blocks; j++){
+		from = BLOCK_LOW(j, blocks, chunkSize);
+		to = BLOCK_LOW(j + 1, blocks, chunkSize);
+		evals += passKMeans(km, data, from, to);
+
+		/* the time goes with the last block only, the buffers are added up */
+		packPass(km->sums, km->counts, km->k, km->dim, km->threadPasses[0].inertia, km->threadPasses[0].changed,
+				j == blocks - 1 ? elapsed : 0, packed + j * packedSize);
+		MPI_Iallreduce(MPI_IN_PLACE, packed + j * packedSize, packedSize, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD, &requests[j]);
+		if(pending++ == 0){
+			since = MPI_Wtime();
+		}
+
+		/* let the earlier reductions progress, and note those done */
+		for(i = 0; i < j; i++){
+			if(requests[i] != MPI_REQUEST_NULL){
+				MPI_Test(&requests[i], &flag, MPI_STATUS_IGNORE);
+				if(flag && --pending == 0){
+					*hidden += MPI_Wtime() - since;
+				}
+			}
+		}
+	}
+
+	waitStart = MPI_Wtime();
+	if(pending > 0){
+		*hidden += waitStart - since;
+	}
+	MPI_Waitall(blocks, requests, MPI_STATUSES_IGNORE);
+	*exposed += MPI_Wtime() - waitStart;
+
+	for(j = 1; j < blocks; j++){
+		for(t = 0; t < packedSize; t++){
+			packed[t] += packed[j * packedSize + t];
+		}
+	}
+
+	free(requests);
+
+	return evals;
 }
 
 /*
@@ -261,174 +1272,349 @@ int main(int argc, char **argv){
 
 	char *inputFileName = NULL;
 	char *centFileName = NULL;
-	int r = FALSE;
+	int r = INIT_CHUNKS;
+	unsigned seed = (unsigned) time(NULL);
+	int a = FALSE;	/* whether skip distance computations with bounds */
+	int kernel = KERNEL_AUTO;	/* the assignment kernel requested */
+	int picked;	/* the assignment kernel run */
+	int g = FALSE;	/* whether use the generic assignment kernel */
+	int delta = 0;	/* iterations between full sums of the delta updates */
+	int full = 0;	/* number of iterations summing all the points */
+	int pipeline = 0;	/* blocks per process of the overlapped reductions */
+	double hidden = 0, exposed = 0;	/* seconds of the reductions behind the assignment, and waited for */
+	double waitStart;
 	int size;	/* line count of input data */
-	Point *data;	/* input data points */
-	Point *centroids; /* centroids */
-	Point *tempC; /* temporary centroids array */
-	Point *globalC; /* temporary global centroids array for MPI_Reduce */
-	int *labels; /* label of clusters for each point */
-	int *counts; /* number of points per cluster */
-	int *globalCounts; /* global number of points per cluster for MPI_Reduce */
-	int k, i, j, done, loops;
-	float tempX, tempY, minDist, dist;
+	int dim;	/* number of dimensions */
+	float *centroids = NULL; /* centroids */
+	KMeans *km;	/* the workspaces of the passes over the local points */
+	double *packed; /* sums, counts and measures of a pass, for MPI_Allreduce */
+	double *totals;	/* the packed pass of all processes */
+	float *start;	/* the initial centroids */
+	Node node;	/* the processes sharing memory with this one */
+	size_t packedSize;
+	int k, i, done, loops;
+	int whole;	/* whether this iteration sums up all the points */
+	int threads = 0;	/* threads per process, 0 for the default */
+	int balance = 0;	/* iterations timed before balancing the points */
+	double balanced = -1;	/* seconds spent assigning before balancing, -1 if not yet */
+	double slowest, mean;
+	int period = 0;	/* iterations between checkpoints */
+	int resume = FALSE;	/* whether resume from the checkpoint */
+	int first;	/* the iteration this run starts from */
+	Checkpoint saved;
+	Snapshot snapshot;
+#ifdef _OPENMP
+	int provided;	/* thread support of the MPI library */
+#endif
+	long evals, globalEvals;	/* number of distances computed */
+	double assignStart, assignTime = 0;	/* seconds spent assigning the points */
+	Convergence stop;	/* the rules ending the iterations, checked by every process */
+	double shift;
 
 	/*defination for MPI*/
 	int id; /* current process id */
 	int p; /* number of processors */
 	int chunkSize;
+	int *offsets;	/* index of the first point of each process */
+	int given;	/* whether the centroids are given in a file */
+	int nameLength;
 	double elapsed;
 	MPI_Status status;
-	MPI_Op MPI_Sum_point;
-	Point *partialData;
-	int *partialLabels;
+	float *partialData;
 
+#ifdef _OPENMP
+	/* threads assign the points, only the master thread calls MPI */
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#else
 	MPI_Init(&argc, &argv);
+#endif
 	MPI_Barrier(MPI_COMM_WORLD);
 	elapsed = - MPI_Wtime();
 	MPI_Comm_rank (MPI_COMM_WORLD, &id);
 	MPI_Comm_size (MPI_COMM_WORLD, &p);
 
-	/* Create MPI_POINT struct */
 	MPI_Datatype MPI_POINT;
-	MPI_Datatype type = MPI_FLOAT;
-	int blockLen = 2;
-	MPI_Aint displacement = 0;
-	MPI_Type_create_struct(1, &blockLen, &displacement, &type, &MPI_POINT);
-	MPI_Type_commit(&MPI_POINT);
 
 	if(id == ROOT){
 		k = 0;
-		getCmdOptions(argc, argv, &inputFileName, &k, &r, &centFileName);
-		data = readData(inputFileName, &size);
-		if(centFileName != NULL){
-			centroids = readCentroids(centFileName, k);
-		}else{
-			centroids = initialCentroids(data, size, k, r);
+		initConvergence(&stop);
+		getCmdOptions(argc, argv, &inputFileName, &k, &r, &seed, &centFileName, &a, &kernel, &g, &delta, &pipeline, &threads, &balance, &period, &resume, &stop);
+		srand(seed);
+		printf("Random seed %u.\n", seed);
+		given = centFileName != NULL;
+		if(pipeline > 0 && delta > 0){
+			printf("The delta updates of -d keep the sums of whole passes, not used with -o.\n");
+			delta = 0;
 		}
+		nameLength = strlen(inputFileName) + 1;
 
-		printf("=====initial centroids=====\n");
-		for(i = 0; i < k; i++){
-			printf("%f %f\n", centroids[i].x, centroids[i].y);
-		}
-		printf("===========================\n");
-
-		/* sending data to slave processors */
+		/* sending the options to slave processors */
 		for(i = 1; i < p; i++){
-			chunkSize = BLOCK_SIZE(i, p, size);
-			printf("Sending %d data to process %d\n", chunkSize, i);
-			MPI_Send(&chunkSize, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&nameLength, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(inputFileName, nameLength, MPI_CHAR, i, 0, MPI_COMM_WORLD);
 			MPI_Send(&k, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
-			MPI_Send(centroids, k, MPI_POINT, i, 0, MPI_COMM_WORLD);
-			MPI_Send(data + BLOCK_LOW(i, p, size), chunkSize, MPI_POINT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&a, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&kernel, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&g, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&r, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&given, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&seed, 1, MPI_UNSIGNED, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&delta, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&pipeline, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&threads, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&balance, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&resume, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
+			MPI_Send(&stop, sizeof(Convergence), MPI_BYTE, i, 0, MPI_COMM_WORLD);
 		}
-		printf("All data sent.\n");
-
-		chunkSize = BLOCK_SIZE(ROOT, p, size);
-		partialData = (Point *) realloc(data, chunkSize * sizeof(Point));
 	} else {
-		/* Recieving data from root processor */
-		MPI_Recv(&chunkSize, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		/* Recieving the options from root processor */
+		MPI_Recv(&nameLength, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		inputFileName = (char *) malloc(nameLength);
+		MPI_Recv(inputFileName, nameLength, MPI_CHAR, ROOT, 0, MPI_COMM_WORLD, &status);
 		MPI_Recv(&k, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
-		centroids = (Point *) calloc(k, sizeof(Point));
-		MPI_Recv(centroids, k, MPI_POINT, ROOT, 0, MPI_COMM_WORLD, &status);
-		partialData = (Point *) calloc(chunkSize, sizeof(Point));
-		MPI_Recv(partialData, chunkSize, MPI_POINT, ROOT, 0, MPI_COMM_WORLD, &status);
-		printf("Process %d recieved %d data\n", id, chunkSize);
-	}
-
-	partialLabels = (int *) calloc(chunkSize, sizeof(int));
-	counts = (int *) calloc(k, sizeof(int));
-	globalCounts = (int *) calloc(k, sizeof(int));
-	tempC = (Point *) calloc(k, sizeof(Point));
-	globalC = (Point *) calloc(k, sizeof(Point));
-	MPI_Op_create(sumPoint, TRUE, &MPI_Sum_point);
-	done = TRUE;
-	loops = 0;
-	do{
-		/* initialize the helper arrays */
+		MPI_Recv(&a, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&kernel, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&g, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&r, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&given, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&seed, 1, MPI_UNSIGNED, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&delta, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&pipeline, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&threads, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&balance, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		MPI_Recv(&resume, 1, MPI_INT, ROOT, 0, MPI_COMM_WORLD, &status);
+		/* every process checks the rules, only root prints the iterations */
+		MPI_Recv(&stop, sizeof(Convergence), MPI_BYTE, ROOT, 0, MPI_COMM_WORLD, &status);
+		/* every process draws its own random numbers */
+		srand(seed + id);
+	}
+
+#ifdef _OPENMP
+	if(threads > 0){
+		omp_set_num_threads(threads);
+	}
+	if(id == ROOT){
+		printf("Each process runs %d threads.\n", omp_get_max_threads());
+		if(provided < MPI_THREAD_FUNNELED){
+			printf("The MPI library does not support threads, it may fail with more than one.\n");
+		}
+	}
+#else
+	if(id == ROOT && threads > 1){
+		printf("Built without OpenMP, -p is ignored.\n");
+	}
+#endif
+
+	/* every process reads its own points */
+	offsets = (int *) malloc((p + 1) * sizeof(int));
+	partialData = readPartition(inputFileName, id, p, offsets, &dim);
+	size = offsets[p];
+	chunkSize = offsets[id + 1] - offsets[id];
+	printf("Process %d read %d points.\n", id, chunkSize);
+
+	/* Create MPI_POINT type, a point is dim floats */
+	MPI_Type_contiguous(dim, MPI_FLOAT, &MPI_POINT);
+	MPI_Type_commit(&MPI_POINT);
+
+	/* each rank picks the best kernel of its own host */
+	picked = supportedKernel(kernel);
+	if(kernel != KERNEL_AUTO && picked != kernel){
+		printf("Kernel %s is not supported by this CPU.\n", kernelName(kernel));
+	}
+	printf("Using %s%s assignment kernel.\n", g ? "generic " : "", kernelName(picked));
+
+	if(resume){
+		/* the iterations go on from the checkpoint, no seeding */
+		start = id == ROOT ? readCheckpoint(&saved, k, dim, size) : (float *) calloc((size_t) k * dim, sizeof(float));
+		MPI_Bcast(&saved, sizeof(Checkpoint), MPI_BYTE, ROOT, MPI_COMM_WORLD);
+	}else if(given){
+		start = id == ROOT ? readCentroids(centFileName, k, dim) : (float *) calloc((size_t) k * dim, sizeof(float));
+	}else if(r == INIT_PLUSPLUS){
+		start = parallelCentroids(partialData, offsets, dim, k, picked, g, id, p, MPI_POINT);
+	}else{
+		start = initialCentroids(partialData, offsets, dim, k, r, id, p);
+	}
+	MPI_Bcast(start, k, MPI_POINT, ROOT, MPI_COMM_WORLD);
+
+	/* the processes of a node share one copy of the centroids */
+	createNode(&node, k, dim);
+	if(node.rank == 0){
+		memcpy(node.centroids, start, (size_t) k * dim * sizeof(float));
+	}
+	free(start);
+	centroids = node.centroids;
+	MPI_Reduce(&node.size, &i, 1, MPI_INT, MPI_MAX, ROOT, MPI_COMM_WORLD);
+	if(id == ROOT){
+		printf("Up to %d processes share the memory of a node.\n", i);
+	}
+	MPI_Barrier(node.local);
+
+	if(id == ROOT){
+		printf("=====initial centroids=====\n");
 		for(i = 0; i < k; i++){
-			counts[i] = 0;
-			tempC[i].x = 0;
-			tempC[i].y = 0;
+			printPoint(stdout, centroids + (size_t) i * dim, dim);
 		}
+		printf("===========================\n");
+	}
 
-		for(i = 0; i < chunkSize; i++){
-			minDist = FLT_MAX;
-			for(j = 0; j < k; j++){
-				/* no need to compute the sqrt, we just need the value for comparison */
-				dist = pow(partialData[i].x - centroids[j].x, 2) +
-						pow(partialData[i].y - centroids[j].y, 2);
-				if(dist < minDist){
-					minDist = dist;
-					partialLabels[i] = j;
-				}
+	/* the library runs the passes over the shared centroids, this loop adds them up between the processes */
+	km = createKMeans(k, dim, threads);
+	if(km == NULL){
+		printf("Process %d can not allocate the workspaces.\n", id);
+		exit(-1);
+	}
+	km->a = a;
+	km->delta = delta;
+	km->kernel = picked;
+	km->generic = g;
+	km->stop = stop;
+	km->centroids = centroids;
+	if(!beginKMeans(km, chunkSize)){
+		printf("Process %d can not allocate the workspaces.\n", id);
+		exit(-1);
+	}
+	packedSize = PACKED_SIZE(k, dim);
+	/* a blocking pass is packed right into the slot of this process */
+	packed = pipeline > 0 ? (double *) malloc(pipeline * packedSize * sizeof(double)) : node.slots + node.rank * packedSize;
+	done = TRUE;
+	loops = 0;
+	evals = 0;
+	startConvergence(&stop);
+	snapshot.pending = FALSE;
+	if(resume){
+		loops = saved.loops;
+		full = saved.full;
+		stop.start -= saved.seconds;
+		stop.lastInertia = saved.lastInertia;
+		if(id == ROOT){
+			printf("Resumed after %d iterations of %.3f s.\n", loops, saved.seconds);
+		}
+	}
+	first = loops;
+	do{
+		if(pipeline > 0){
+			/* the reductions of the first blocks run while the next ones are assigned */
+			assignStart = MPI_Wtime();
+			waitStart = exposed;
+			/* the bounds keep the centroids from before the leader of the node moves them */
+			startPass(km, TRUE);
+			evals += pipelinedPass(km, partialData, chunkSize, pipeline, id == ROOT ? elapsedConvergence(&stop) : 0, packed, &hidden, &exposed);
+			assignTime += MPI_Wtime() - assignStart - (exposed - waitStart);
+			totals = packed;
+			++full;
+		}else{
+			/*
+			 * compute the distance between each point and each centroid and
+			 * sum up all the points, which also clears the drift of the delta
+			 * updates, or only move the points changing cluster between the
+			 * sums kept by each process
+			 */
+			assignStart = MPI_Wtime();
+			/* points moved by the balancing or resumed come without their share of the sums */
+			whole = delta <= 0 || loops % delta == 0 || loops == balance || loops == first;
+			if(whole){
+				++full;
 			}
-
-			++counts[partialLabels[i]];
+			startPass(km, whole);
+			evals += passKMeans(km, partialData, 0, chunkSize);
+			carrySums(km);
+			assignTime += MPI_Wtime() - assignStart;
 
 			/*
-			 * simply add on the x and y of each point,
-			 * for further computation of new centroid
+			 * add up the sums, counts and measures of all processes, within
+			 * each node then between the nodes, the time of root makes every
+			 * process stop together
 			 */
-			tempC[partialLabels[i]].x += partialData[i].x;
-			tempC[partialLabels[i]].y += partialData[i].y;
+			packPass(km->totals, km->totalCounts, k, dim, km->threadPasses[0].inertia, km->threadPasses[0].changed,
+					id == ROOT ? elapsedConvergence(&stop) : 0, packed);
+			waitStart = MPI_Wtime();
+			totals = reduceNode(&node);
+			exposed += MPI_Wtime() - waitStart;
 		}
-		/* reduce the temporary centroids and counts */
-		MPI_Reduce(tempC, globalC, k, MPI_POINT, MPI_Sum_point, ROOT, MPI_COMM_WORLD);
-		MPI_Reduce(counts, globalCounts, k, MPI_INT, MPI_SUM, ROOT, MPI_COMM_WORLD);
 
-		if(id == ROOT){
-			/* compute and broadcast the new centroid */
-			done = TRUE;
-			for(i = 0; i < k; i++){
-				tempX = globalCounts[i] ? globalC[i].x / globalCounts[i] : 0;
-				tempY = globalCounts[i] ? globalC[i].y / globalCounts[i] : 0;
-				if(centroids[i].x != tempX || centroids[i].y != tempY){
-					done = FALSE; /* quit the loop until no change */
-					centroids[i].x = tempX;
-					centroids[i].y = tempY;
-				}
-			}
-			++loops;
-		} else {
-			done = FALSE;
+		/* the leader of each node computes the same new centroids */
+		shift = nodeCentroids(&node, totals, k, dim);
+		++loops;
+		done = convergedAfter(&stop, loops, shift, totals[packedSize - 3], (long) totals[packedSize - 2], size, totals[packedSize - 1]);
+		if(stop.verbose && id == ROOT){
+			printIteration(&stop);
 		}
 
-		MPI_Bcast(centroids, k, MPI_POINT, ROOT, MPI_COMM_WORLD);
-		MPI_Bcast(&done, 1, MPI_INT, ROOT, MPI_COMM_WORLD);
+		if(balance > 0 && loops == balance && !done){
+			/* every process times its own assignment, the points follow the speeds */
+			partialData = balancePoints(partialData, offsets, assignTime, km, id, p, MPI_POINT);
+			chunkSize = offsets[id + 1] - offsets[id];
+			balanced = assignTime;
+		}
+
+		if(id == ROOT && period > 0){
+			finishCheckpoint(&snapshot, FALSE);
+			if(!done && loops % period == 0){
+				saved.k = k;
+				saved.dim = dim;
+				saved.size = size;
+				saved.loops = loops;
+				saved.full = full;
+				saved.seconds = elapsedConvergence(&stop);
+				saved.lastInertia = stop.lastInertia;
+				startCheckpoint(&snapshot, &saved, centroids);
+			}
+		}
 
 	} while(!done);
 
-	if(id == ROOT){
-		labels = partialLabels;
-		labels = (int *) realloc(partialLabels, size * sizeof(int));
-		/* gather labels in root process */
-		for(i = 1; i < p; i++){
-			MPI_Recv(labels + BLOCK_LOW(i, p, size), chunkSize, MPI_INT, i, 0, MPI_COMM_WORLD, &status);
-			printf("Recieved %d labels from %d.\n", chunkSize, i);
-		}
+	if(delta > 0 && (loops - 1) % delta != 0){
+		/* the last centroids are the exact means of their clusters, without drift */
+		memset(km->counts, 0, k * sizeof(int));
+		memset(km->sums, 0, (size_t) k * dim * sizeof(float));
+		accumulatePoints(partialData, dim, 0, chunkSize, km->labels, km->sums, km->counts, NULL);
+		packPass(km->sums, km->counts, k, dim, 0, 0, 0, packed);
+		nodeCentroids(&node, reduceNode(&node), k, dim);
+	}
+
+	finishCheckpoint(&snapshot, TRUE);
+	MPI_Reduce(&evals, &globalEvals, 1, MPI_LONG, MPI_SUM, ROOT, MPI_COMM_WORLD);
+	if(balanced >= 0){
+		balanced = assignTime - balanced;
+		MPI_Reduce(&balanced, &slowest, 1, MPI_DOUBLE, MPI_MAX, ROOT, MPI_COMM_WORLD);
+		MPI_Reduce(&balanced, &mean, 1, MPI_DOUBLE, MPI_SUM, ROOT, MPI_COMM_WORLD);
+		mean /= p;
+	}
 
+	if(id == ROOT){
 		printf("Iterated %d times.\n", loops);
-		writeToFile(labels, size, centroids, k);
-	} else {
-		printf("Process %d sending %d labels to root.\n", id, chunkSize);
-		MPI_Send(partialLabels, chunkSize, MPI_INT, ROOT, 0, MPI_COMM_WORLD);
+		printf("Stopped as %s.\n", stop.reason);
+		printf("Computed %ld distances.\n", globalEvals);
+		if(delta > 0){
+			printf("Summed all the points in %d of %d loops.\n", full, loops);
+		}
+		printf("Root spent %.3f s assigning points.\n", assignTime);
+		if(balanced >= 0){
+			printf("After balancing, the slowest process assigned for %.3f s, %.2f times the mean.\n", slowest, mean > 0 ? slowest / mean : 1);
+		}
+		printf("Root waited %.3f s for the reductions", exposed);
+		if(pipeline > 0){
+			printf(", and had some running behind the assignment for %.3f s", hidden);
+		}
+		printf(".\n");
 	}
+	writeToFile(km->labels, chunkSize, size, centroids, k, dim, id);
 
 	/*  Clean up */
 	free(inputFileName);
-	free(data);
-	free(centroids);
-	free(counts);
-	free(globalCounts);
-	free(tempC);
-	free(globalC);
+	free(partialData);
+	freeKMeans(km);
+	if(pipeline > 0){
+		free(packed);
+	}
+	freeNode(&node);
+	free(offsets);
+	MPI_Type_free(&MPI_POINT);
 
 	MPI_Barrier(MPI_COMM_WORLD);
 	elapsed += MPI_Wtime();
 	if(id == ROOT){
-		printf("%d points assigned to %d clusters in %.2f s.\n", size, k, elapsed);
+		printf("%d points of %d dimensions assigned to %d clusters in %.2f s.\n", size, dim, k, elapsed);
 	}
 
 	MPI_Finalize();
@@ -7,6 +7,13 @@
 
 
 #include "kmeans.h"
+#include "hamerly.h"
+#include "kernels.h"
+#include "loader.h"
+#include "seeding.h"
+#include "convergence.h"
+#include "minibatch.h"
+#include "libkmeans.h"
 #include <omp.h>
 
 /*
@@ -17,8 +24,22 @@ void help(){
 	printf("<-i inputFileName>	:	input data file path and name\n");
 	printf("[-k k-means]		:	the number of k, should be larger than 0, default 9\n");
 	printf("[-r]			:	whether create centroids randomly\n");
+	printf("[-P]			:	create the centroids with k-means++\n");
+	printf("[-S seed]		:	seed of the random numbers, default the time\n");
 	printf("[-c centroidFileName]	:	the starting centroids file\n");
+	printf("[-b binaryFileName]	:	convert the input data to a binary file and exit\n");
 	printf("[-p numOfThreads]       :       number of threads to spawn\n");
+	printf("[-m batchSize]		:	run mini-batch k-means with batches of this many points\n");
+	printf("[-n loops]		:	most iterations, or batches of mini-batch k-means (default %d), default no limit\n", DEFAULT_BATCHES);
+	printf("[-t seconds]		:	time budget of the iterations, default none\n");
+	printf("[-x shift]		:	stop once no centroid moves further than this, default 0\n");
+	printf("[-e fraction]		:	stop once the inertia changes by less than this fraction\n");
+	printf("[-l fraction]		:	stop once fewer than this fraction of the labels change\n");
+	printf("[-v]			:	print the statistics of every iteration\n");
+	printf("[-d period]		:	update the sums by the points changing cluster, re-summing all every period iterations\n");
+	printf("[-a]			:	skip distance computations with triangle inequality bounds\n");
+	printf("[-K kernel]		:	assignment kernel: scalar, sse4, avx2 or avx512, default the best supported\n");
+	printf("[-g]			:	use the generic assignment kernel for every dimension\n");
 	printf("[-h]			:	print this help\n");
 }
 
@@ -31,16 +52,25 @@ void help(){
  * @param argv			char**	list of arguments
  * @param inputFileName	char**	input file path and name
  * @param k				int*	k-means
- * @param r				int*	whether create centroids randomly
+ * @param r				int*	how to create the centroids, INIT_CHUNKS, INIT_RANDOM or INIT_PLUSPLUS
+ * @param seed			unsigned*	seed of the random numbers
  * @param centFileName		char**	the starting centroids file
+ * @param p				int*	number of threads
+ * @param a				int*	whether skip distance computations with bounds
+ * @param kernel			int*	the assignment kernel requested
+ * @param g				int*	whether use the generic assignment kernel
+ * @param binFileName	char**	the binary file to convert the input data to
+ * @param batch			int*	number of points per batch of mini-batch k-means, 0 for full batches
+ * @param delta			int*	iterations between full sums of the delta updates, 0 for no delta updates
+ * @param stop			Convergence*	the rules ending the iterations
  *
  * @return void
  */
-void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, char **centFileName, int *p){
+void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, unsigned *seed, char **centFileName, int *p, int *a, int *kernel, int *g, char **binFileName, int *batch, int *delta, Convergence *stop){
 	int c;
 	opterr = 0;
 
-	while((c = getopt(argc, argv, "i:k:c:p:hr")) != -1){
+	while((c = getopt(argc, argv, "i:k:c:p:b:m:n:t:x:e:l:d:S:hrPaK:gv")) != -1){
 		switch(c){
 			case 'i':
 				*inputFileName = (char *)malloc(strlen(optarg) * sizeof(optarg));
@@ -50,12 +80,57 @@ void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r,
 				*k = atoi(optarg);
 				break;
 			case 'r':
-				*r = TRUE;
+				*r = INIT_RANDOM;
+				break;
+			case 'P':
+				*r = INIT_PLUSPLUS;
+				break;
+			case 'S':
+				*seed = (unsigned) strtoul(optarg, NULL, 10);
+				break;
+			case 'a':
+				*a = TRUE;
+				break;
+			case 'K':
+				if((*kernel = kernelByName(optarg)) == KERNEL_AUTO){
+					printf("Unknown kernel: %s\n", optarg);
+				}
+				break;
+			case 'g':
+				*g = TRUE;
 				break;
 			case 'c':
 				*centFileName = (char *)malloc(strlen(optarg) * sizeof(optarg));
 				strcpy(*centFileName, optarg);
 				break;
+			case 'b':
+				*binFileName = (char *)malloc(strlen(optarg) + 1);
+				strcpy(*binFileName, optarg);
+				break;
+			case 'm':
+				*batch = atoi(optarg);
+				break;
+			case 'n':
+				stop->loops = atoi(optarg);
+				break;
+			case 't':
+				stop->seconds = atof(optarg);
+				break;
+			case 'x':
+				stop->shift = atof(optarg);
+				break;
+			case 'e':
+				stop->inertia = atof(optarg);
+				break;
+			case 'l':
+				stop->changed = atof(optarg);
+				break;
+			case 'd':
+				*delta = atoi(optarg);
+				break;
+			case 'v':
+				stop->verbose = TRUE;
+				break;
 			case 'h':
 				help();
 				exit(0);
@@ -79,32 +154,29 @@ void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r,
 }
 
 /*
- * Reads the data points from input file
+ * Reads the centroids from input file
  *
  * This function will change the value of count
  *
  * @param fileName	char*	the file path and name to be read
- * @param count		int*	number of file lines
+ * @param count		int	number of file lines
+ * @param dim		int	number of dimensions
  *
- * @return data		Point*	array storing the points
+ * @return data		float*	the centroids, one row of dim values each
  *
  */
-Point *readData(char *fileName, int *count){
+float *readCentroids(char *fileName, int count, int dim){
 	FILE *pRead;
-	Point *data = (Point *) malloc(sizeof(Point));
-	float nX, nY;
+	float *data = (float *) calloc((size_t) count * dim, sizeof(float));
+	int i;
 
 	if((pRead = fopen(fileName, "r")) == NULL){
 		printf("Fail to open file: %s", fileName);
 		exit(-1);
 	}
 
-	*count = 0;
-	while(fscanf(pRead, "%f %f\n", &nX, &nY) != EOF){
-		data = (Point *) realloc(data, (*count+1) * sizeof(Point));
-		data[*count].x = nX;
-		data[*count].y = nY;
-		++ *count;
+	for(i = 0; i < count * dim; i++){
+		fscanf(pRead, "%f", &data[i]);
 	}
 	fclose(pRead);
 
@@ -112,182 +184,178 @@ Point *readData(char *fileName, int *count){
 }
 
 /*
- * Reads the centroids from input file
+ * Print a point as one line of dim values
  *
- * This function will change the value of count
+ * @param pWrite	FILE*	the file to write to
+ * @param point		float*	the dim values of the point
+ * @param dim		int		number of dimensions
  *
- * @param fileName	char*	the file path and name to be read
- * @param count		int	number of file lines
+ * @return void
+ */
+void printPoint(FILE *pWrite, float *point, int dim){
+	int t;
+
+	for(t = 0; t < dim; t++){
+		fprintf(pWrite, t ? " %f" : "%f", point[t]);
+	}
+	fprintf(pWrite, "\n");
+}
+
+/*
+ * Print the measures of the last iteration, kept by the rules
  *
- * @return data		Point*	array storing the points
+ * @param c		Convergence*	the rules, after the iteration was checked
  *
+ * @return void
  */
-Point *readCentroids(char *fileName, int count){
-	FILE *pRead;
-	Point *data = (Point *) calloc(count, sizeof(Point));
-	int i;
+void printIteration(Convergence *c){
+	printf("Loop %d: largest shift %.6g, inertia %.6g, %ld labels changed, %.3f s.\n",
+			c->lastLoop, c->lastShift, c->lastInertia, c->lastChanged, c->lastElapsed);
+}
 
-	if((pRead = fopen(fileName, "r")) == NULL){
-		printf("Fail to open file: %s", fileName);
+/*
+ * Read the points of the input file, reporting the time it took, or
+ * stop with an error
+ *
+ * This function will change the value of size and dim
+ *
+ * @param fileName	char*	the file path and name to be read
+ * @param size		int*	number of points
+ * @param dim		int*	number of dimensions
+ *
+ * @return float*	the points, one row of dim values per point, released with freeData
+ */
+float *loadData(char *fileName, int *size, int *dim){
+	struct timespec start, stop;
+	struct stat st;
+	float *data;
+	double seconds;
+	int error, threads = 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if((data = readData(fileName, size, dim, &error)) == NULL){
+		printf("%s: %s\n", loadError(error), fileName);
 		exit(-1);
 	}
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
 
-	for(i = 0; i < count; i++){
-		fscanf(pRead, "%f %f\n", &data[i].x, &data[i].y);
+	if(mappedData(data)){
+		printf("Mapped %d points in %.3f s.\n", *size, seconds);
+	}else{
+		threads = omp_get_max_threads();
+		printf("Loaded %d points in %.3f s (%.1f MB/s, %d threads).\n", *size, seconds,
+				stat(fileName, &st) == 0 ? st.st_size / 1e6 / seconds : 0, threads);
 	}
-	fclose(pRead);
 
 	return data;
 }
 
 /*
- * k-means algorithm inplementation
+ * Mini-batch k-means on the context, printing the initial centroids and
+ * the statistics of the run of the library
+ *
+ * This function will change the value of km
  *
- * This function will change the value of centroids
+ * @param km		KMeans*	the context, its centroids set
+ * @param data		float*	the input data, one row of dim values per point
+ * @param size		int		number of points
+ * @param batch		int		number of points per batch
+ * @param batches	int		most batches to run
+ * @param seconds	double	time budget of the batches, 0 for none
  *
- * @param data		Point*		the input data array
+ * @return int*	the label of each point, held by km
+ */
+int *miniBatch(KMeans *km, float *data, int size, int batch, int batches, double seconds){
+	struct timespec start, stop;
+	int *labels;
+	int i;
+
+	printf("=====initial centroids=====\n");
+	for(i = 0; i < km->k; i++){
+		printPoint(stdout, km->centroids + (size_t) i * km->dim, km->dim);
+	}
+	printf("===========================\n");
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if((labels = miniBatchKMeans(km, data, size, batch, batches, seconds)) == NULL){
+		printf("Unable to allocate the labels of %d points\n", size);
+		exit(-1);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	printf("Ran %d batches of %d points in %.3f s.\n", km->loops, batch,
+			(stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9 - km->assignTime);
+	printf("Spent %.3f s assigning points.\n", km->assignTime);
+	printf("Inertia %.6g.\n", km->inertia);
+
+	return labels;
+}
+
+/*
+ * k-means algorithm inplementation, printing the initial centroids and
+ * the statistics of the run of the library
+ *
+ * This function will change the value of km
+ *
+ * @param km		KMeans*		the context, its centroids, options and threads set
+ * @param data		float*		the input data, one row of dim values per point
  * @param size		int			the size of input data
- * @param k			int			k-means
- * @param centroids	Point*		array storing the k centroids
  *
- * @return labels	int*	an array storing the label of each point
+ * @return labels	int*	an array storing the label of each point, held by km
  *
  */
-int *kmeans(Point *data, int size, int k, Point *centroids, int p){
-	int *labels = (int *) calloc(size, sizeof(int));
-	int i, j, done, loops, check;
-	float minDist, dist;
-	float tempX, tempY;
-	Point *tempC = (Point *) calloc(k, sizeof(Point)); /*temporary centroids*/
-	int *counts = (int *) calloc(k, sizeof(int));	/*counts of each cluster*/
+int *kmeans(KMeans *km, float *data, int size){
+	int *labels;
+	int i;
 
 	printf("=====initial centroids=====\n");
-	for(i = 0; i < k; i++){
-		printf("%f %f\n", centroids[i].x, centroids[i].y);
+	for(i = 0; i < km->k; i++){
+		printPoint(stdout, km->centroids + (size_t) i * km->dim, km->dim);
 	}
 	printf("===========================\n");
 
-	/* loop to determine the clusters */
-	done = TRUE;
-	loops = 0;
-	check = 0;
-
-	do{
-
-#pragma omp parallel for num_threads(p)
-	    /* initialize the helper arrays */
-	    for(i = 0; i < k; i++){
-	      counts[i] = 0;
-	      tempC[i].x = 0;
-	      tempC[i].y = 0;
-	    }
-
-#pragma omp parallel for private(j, dist, minDist) num_threads(p)
-	    for(i = 0; i < size; i++){
-	      minDist = FLT_MAX;
-	      /* compute the distance between the point and each centroid*/
-	      for(j = 0; j < k; j++){
-		/* no need to compute the sqrt, we just need the value for comparison */
-		dist = pow(data[i].x - centroids[j].x, 2) +
-		  pow(data[i].y - centroids[j].y, 2);
-
-		/* assign shortest distance to the j-th cluster*/
-		if(dist < minDist){
-		  minDist = dist;
-		  labels[i] = j;
-		}
-	      }
-	    }
-	  
-
-	    /* unable to reduce arrays here */
-	    /* possible to create local-arrays in thread and merge but performance improvement unlikely */
-	    for (i = 0; i < size; i++) {
-	      /* count the number of points in the j-th cluster */
-	      ++counts[labels[i]];
-	      /*printf("Total counts in cluster %d: %d\n", labels[i], counts[labels[i]]);*/
-
-	      /*
-	       * simply add on the x and y of each point,
-	       * for further computation of new centroid
-	       */
-	      tempC[labels[i]].x += data[i].x;
-	      tempC[labels[i]].y += data[i].y;
-		
-	    }
-		
-	    /* update the centroids */
-#pragma omp parallel for private(tempX, tempY) reduction(+:check) num_threads(p)
-	    for(i = 0; i < k; i++){
-	      /* calculate new centroids of the new cluster */
-	      tempX = counts[i] ? tempC[i].x / counts[i] : 0;
-	      tempY = counts[i] ? tempC[i].y / counts[i] : 0;
-	      if(centroids[i].x != tempX || centroids[i].y != tempY){
-		check += 1; /* quit the loop until no change */
-		centroids[i].x = tempX;
-		centroids[i].y = tempY;
-	      }
-	    }
-
-	    if (check >= 1) {
-	      done = FALSE; /* if any new centroid doesn't equal old centroid, check > 1, and done will equate to 0 to continue the loop */
-	    } else {
-	      done = TRUE;
-	    }
-
-	    ++loops;
-	  
-	    /* re-initialize check variable */
-	    check = 0;
-	  
-	}while(!done);
-
-	printf("Iterated %d loops.\n", loops);
+	if((labels = fitKMeans(km, data, size)) == NULL){
+		printf("Unable to allocate the workspaces of %d points\n", size);
+		exit(-1);
+	}
 
-	/*  Clean up */
-	free(tempC);
-	free(counts);
+	printf("Iterated %d loops.\n", km->loops);
+	printf("Stopped as %s.\n", km->stop.reason);
+	printf("Computed %ld distances.\n", km->evals);
+	if(km->delta > 0){
+		printf("Summed all the points in %d of %d loops.\n", km->full, km->loops);
+	}
+	printf("Spent %.3f s assigning points.\n", km->assignTime);
+	printf("Inertia %.6g.\n", km->inertia);
 
 	return labels;
 }
 
 /*
- * Initialize the centroids, randomly select initial points
+ * Initialize the centroids, from the first point of k chunks of the data,
+ * at random coordinates or with k-means++
  *
- * @param data	Point*	array of input points
+ * @param data	float*	the input data, one row of dim values per point
  * @param size	int		number of points
+ * @param dim	int		number of dimensions
  * @param k		int		number of clusters
- * @param r		int		whether create randomly
+ * @param r		int		how to create them, INIT_CHUNKS, INIT_RANDOM or INIT_PLUSPLUS
  *
- * @return Point* array of centroids
+ * @return float* the k centroids, one row of dim values each
  *
  */
-Point *initialCentroids(Point *data, int size, int k, int r){
-	Point *c = (Point *) calloc(k, sizeof(Point));
-	int i,j;
+float *initialCentroids(float *data, int size, int dim, int k, int r){
+	float *c = (float *) calloc((size_t) k * dim, sizeof(float));
+	int i;
 	char *fileName = "initial.txt";
 	FILE *pWrite;
 
+	seedCentroids(data, size, dim, k, r, c);
 	if(k > size){
 		k = size;
 	}
 
-	srand((unsigned) time(NULL));
-	for(i = j = 0; i < k; i++){
-		if(r){
-			c[i].x = (float) (rand() % 1000) / 1000 * 8;
-			c[i].y = (float) (rand() % 1000) / 1000 * 8;
- 		}else{
- 			/*
-			 * pick the first point from k chunks,
-			 * it's not real random, but acceptable
-			 */
-			j += size/k;
-			c[i].x = data[j].x;
-			c[i].y = data[j].y;
- 		}
-	}
-
 	/* write to file */
 	if((pWrite = fopen(fileName, "w")) == NULL){
 		printf("Fail to open output file: %s\n", fileName);
@@ -295,7 +363,7 @@ Point *initialCentroids(Point *data, int size, int k, int r){
 	}
 
 	for(i = 0; i < k; i++){
-		fprintf(pWrite, "%f %f\n", c[i].x, c[i].y);
+		printPoint(pWrite, c + (size_t) i * dim, dim);
 	}
 
 	printf("Successfully wrote initial centroids into file: %s\n", fileName);
@@ -310,12 +378,13 @@ Point *initialCentroids(Point *data, int size, int k, int r){
  *
  * @param labels	int*	The array storing cluster labels for each point
  * @param size		int		The size of data
- * @param centroids	Point*	The array storing k centroids
+ * @param centroids	float*	The k centroids, one row of dim values each
  * @param k			int		k-means
+ * @param dim		int		number of dimensions
  *
  * @return void
  */
-void writeToFile(int *labels, int size, Point *centroids, int k){
+void writeToFile(int *labels, int size, float *centroids, int k, int dim){
 	char *outLabelFileName = "labels.txt";
 	char *outCntrdFileName = "centroids.txt";
 	FILE *pWrite;
@@ -342,7 +411,7 @@ void writeToFile(int *labels, int size, Point *centroids, int k){
 	}
 
 	for(i = 0; i < k; i++){
-		fprintf(pWrite, "%f %f\n", centroids[i].x, centroids[i].y);
+		printPoint(pWrite, centroids + (size_t) i * dim, dim);
 	}
 
 	fclose(pWrite);
@@ -357,37 +426,86 @@ int main(int argc, char **argv){
 
 	char *inputFileName = NULL;
 	char *centFileName = NULL;
+	char *binFileName = NULL;	/* where to convert the input data */
+	int batch = 0;	/* points per batch of mini-batch k-means */
+	int delta = 0;	/* iterations between full sums of the delta updates */
+	Convergence stop;	/* the rules ending the iterations */
 	int size;	/* line count of input data*/
-	Point *data;	/* input data points*/
-	Point *centroids;
+	int dim;	/* number of dimensions */
+	int error;	/* why a data file could not be read or written */
+	float *data;	/* input data points*/
+	float *centroids;
 	int *labels;
+	KMeans *km;	/* the context of the library */
 	int k = 0;
-	int r = FALSE;
+	int r = INIT_CHUNKS;
+	unsigned seed = (unsigned) time(NULL);
 	int p = 0;
+	int a = FALSE;
+	int kernel = KERNEL_AUTO;
+	int picked;	/* the assignment kernel run */
+	int g = FALSE;
 	double start, end;
 	start = omp_get_wtime();
 	
-	getCmdOptions(argc, argv, &inputFileName, &k, &r, &centFileName, &p);
+	initConvergence(&stop);
+	getCmdOptions(argc, argv, &inputFileName, &k, &r, &seed, &centFileName, &p, &a, &kernel, &g, &binFileName, &batch, &delta, &stop);
+	srand(seed);
+	printf("Random seed %u.\n", seed);
+	picked = supportedKernel(kernel);
+	if(kernel != KERNEL_AUTO && picked != kernel){
+		printf("Kernel %s is not supported by this CPU.\n", kernelName(kernel));
+	}
+	printf("Using %s%s assignment kernel.\n", g ? "generic " : "", kernelName(picked));
+	if(p > 0){
+		omp_set_num_threads(p);
+	}
+
+	data = loadData(inputFileName, &size, &dim);
 
-	data = readData(inputFileName, &size);
+	if(binFileName != NULL){
+		if((error = writeBinary(binFileName, data, size, dim)) != LOAD_OK){
+			printf("%s: %s\n", loadError(error), binFileName);
+			exit(-1);
+		}
+		printf("Successfully wrote %d points into file: %s\n", size, binFileName);
+		freeData(data);
+		return 0;
+	}
 
 	if(centFileName != NULL){
-		centroids = readCentroids(centFileName, k);
+		centroids = readCentroids(centFileName, k, dim);
 	}else{
-		centroids = initialCentroids(data, size, k, r);
+		centroids = initialCentroids(data, size, dim, k, r);
 	}
 
-	labels = kmeans(data, size, k, centroids, p);
+	if((km = createKMeans(k, dim, p)) == NULL){
+		printf("Unable to allocate the workspaces of %d clusters\n", k);
+		exit(-1);
+	}
+	km->kernel = picked;
+	km->generic = g;
+	memcpy(km->centroids, centroids, (size_t) k * dim * sizeof(float));
+	if(batch > 0){
+		labels = miniBatch(km, data, size, batch, stop.loops > 0 ? stop.loops : DEFAULT_BATCHES, stop.seconds);
+	}else{
+		km->a = a;
+		km->delta = delta;
+		km->stop = stop;
+		km->report = stop.verbose ? printIteration : NULL;
+		labels = kmeans(km, data, size);
+	}
+	memcpy(centroids, km->centroids, (size_t) k * dim * sizeof(float));
 
-	writeToFile(labels, size, centroids, k);
+	writeToFile(labels, size, centroids, k, dim);
+	freeKMeans(km);
 
 	/*  Clean up */
 	free(inputFileName);
 	free(centFileName);
+	free(binFileName);
 
-	if(data){
-		free(data);
-	}
+	freeData(data);
 
 	if(centroids){
 		free(centroids);
@@ -395,7 +513,7 @@ int main(int argc, char **argv){
 
 	end = omp_get_wtime();
 	
-	printf("%d points assigned to %d clusters in %.2f s.\n", size, k, (double)(end - start));
+	printf("%d points of %d dimensions assigned to %d clusters in %.2f s.\n", size, dim, k, (double)(end - start));
 
 	return 0;
 }
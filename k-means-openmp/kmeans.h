@@ -16,27 +16,33 @@
 #include <float.h>
 #include <math.h>
 #include <time.h>
-
-typedef struct{
-	float x;
-	float y;
-} Point;
+#include <sys/stat.h>
 
 #define TRUE 1
 #define FALSE 0
 
+struct Convergence;	/* see convergence.h */
+
 void help();
 
-void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, char ** centFileName, int *p);
+void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, unsigned *seed, char ** centFileName, int *p, int *a, int *kernel, int *g, char **binFileName, int *batch, int *delta, struct Convergence *stop);
+
+float *readCentroids(char *fileName, int count, int dim);
+
+void printPoint(FILE *pWrite, float *point, int dim);
+
+void printIteration(struct Convergence *c);
+
+float *loadData(char *fileName, int *size, int *dim);
 
-Point *readData(char *fileName, int *count);
+struct KMeans;	/* see libkmeans.h */
 
-Point *readCentroids(char *fileName, int count);
+int *miniBatch(struct KMeans *km, float *data, int size, int batch, int batches, double seconds);
 
-int *kmeans(Point *data, int n, int k, Point *centroids, int p);
+int *kmeans(struct KMeans *km, float *data, int size);
 
-Point *initialCentroids(Point *data, int size, int k, int r);
+float *initialCentroids(float *data, int size, int dim, int k, int r);
 
-void writeToFile(int *labels, int n, Point *centroids, int k);
+void writeToFile(int *labels, int n, float *centroids, int k, int dim);
 
 #endif /* KMEANS_H_ */
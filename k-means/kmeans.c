@@ -7,6 +7,13 @@
 
 
 #include "kmeans.h"
+#include "hamerly.h"
+#include "kernels.h"
+#include "loader.h"
+#include "seeding.h"
+#include "convergence.h"
+#include "minibatch.h"
+#include "libkmeans.h"
 
 /*
  * Print the usage of this programme
@@ -16,7 +23,22 @@ void help(){
 	printf("<-i inputFileName>	:	input data file path and name\n");
 	printf("[-k k-means]		:	the number of k, should be larger than 0, default 9\n");
 	printf("[-r]			:	whether create centroids randomly\n");
+	printf("[-P]			:	create the centroids with k-means++\n");
+	printf("[-S seed]		:	seed of the random numbers, default the time\n");
 	printf("[-c centroidFileName]	:	the starting centroids file\n");
+	printf("[-b binaryFileName]	:	convert the input data to a binary file and exit\n");
+	printf("[-s blockSize]		:	stream the input in blocks of this many points, for data larger than the memory\n");
+	printf("[-m batchSize]		:	run mini-batch k-means with batches of this many points\n");
+	printf("[-n loops]		:	most iterations, or batches of mini-batch k-means (default %d), default no limit\n", DEFAULT_BATCHES);
+	printf("[-t seconds]		:	time budget of the iterations, default none\n");
+	printf("[-x shift]		:	stop once no centroid moves further than this, default 0\n");
+	printf("[-e fraction]		:	stop once the inertia changes by less than this fraction\n");
+	printf("[-l fraction]		:	stop once fewer than this fraction of the labels change\n");
+	printf("[-v]			:	print the statistics of every iteration\n");
+	printf("[-d period]		:	update the sums by the points changing cluster, re-summing all every period iterations\n");
+	printf("[-a]			:	skip distance computations with triangle inequality bounds\n");
+	printf("[-K kernel]		:	assignment kernel: scalar, sse4, avx2 or avx512, default the best supported\n");
+	printf("[-g]			:	use the generic assignment kernel for every dimension\n");
 	printf("[-h]			:	print this help\n");
 }
 
@@ -29,16 +51,25 @@ void help(){
  * @param argv			char**	list of arguments
  * @param inputFileName	char**	input file path and name
  * @param k				int*	k-means
- * @param r				int*	whether create centroids randomly
+ * @param r				int*	how to create the centroids, INIT_CHUNKS, INIT_RANDOM or INIT_PLUSPLUS
+ * @param seed			unsigned*	seed of the random numbers
  * @param centFileName		char**	the starting centroids file
+ * @param a				int*	whether skip distance computations with bounds
+ * @param kernel			int*	the assignment kernel requested
+ * @param g				int*	whether use the generic assignment kernel
+ * @param binFileName	char**	the binary file to convert the input data to
+ * @param blockSize		int*	number of points of a block when streaming, 0 to load all
+ * @param batch			int*	number of points per batch of mini-batch k-means, 0 for full batches
+ * @param delta			int*	iterations between full sums of the delta updates, 0 for no delta updates
+ * @param stop			Convergence*	the rules ending the iterations
  *
  * @return void
  */
-void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, char **centFileName){
+void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, unsigned *seed, char **centFileName, int *a, int *kernel, int *g, char **binFileName, int *blockSize, int *batch, int *delta, Convergence *stop){
 	int c;
 	opterr = 0;
 
-	while((c = getopt(argc, argv, "i:k:c:hr")) != -1){
+	while((c = getopt(argc, argv, "i:k:c:b:s:m:n:t:x:e:l:d:S:hrPaK:gv")) != -1){
 		switch(c){
 			case 'i':
 				*inputFileName = (char *)malloc(strlen(optarg) * sizeof(optarg));
@@ -48,12 +79,60 @@ void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r,
 				*k = atoi(optarg);
 				break;
 			case 'r':
-				*r = TRUE;
+				*r = INIT_RANDOM;
+				break;
+			case 'P':
+				*r = INIT_PLUSPLUS;
+				break;
+			case 'S':
+				*seed = (unsigned) strtoul(optarg, NULL, 10);
+				break;
+			case 'a':
+				*a = TRUE;
+				break;
+			case 'K':
+				if((*kernel = kernelByName(optarg)) == KERNEL_AUTO){
+					printf("Unknown kernel: %s\n", optarg);
+				}
+				break;
+			case 'g':
+				*g = TRUE;
 				break;
 			case 'c':
 				*centFileName = (char *)malloc(strlen(optarg) * sizeof(optarg));
 				strcpy(*centFileName, optarg);
 				break;
+			case 'b':
+				*binFileName = (char *)malloc(strlen(optarg) + 1);
+				strcpy(*binFileName, optarg);
+				break;
+			case 's':
+				*blockSize = atoi(optarg);
+				break;
+			case 'm':
+				*batch = atoi(optarg);
+				break;
+			case 'n':
+				stop->loops = atoi(optarg);
+				break;
+			case 't':
+				stop->seconds = atof(optarg);
+				break;
+			case 'x':
+				stop->shift = atof(optarg);
+				break;
+			case 'e':
+				stop->inertia = atof(optarg);
+				break;
+			case 'l':
+				stop->changed = atof(optarg);
+				break;
+			case 'd':
+				*delta = atoi(optarg);
+				break;
+			case 'v':
+				stop->verbose = TRUE;
+				break;
 			case 'h':
 				help();
 				exit(0);
@@ -74,32 +153,29 @@ void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r,
 }
 
 /*
- * Reads the data points from input file
+ * Reads the centroids from input file
  *
  * This function will change the value of count
  *
  * @param fileName	char*	the file path and name to be read
- * @param count		int*	number of file lines
+ * @param count		int	number of file lines
+ * @param dim		int	number of dimensions
  *
- * @return data		Point*	array storing the points
+ * @return data		float*	the centroids, one row of dim values each
  *
  */
-Point *readData(char *fileName, int *count){
+float *readCentroids(char *fileName, int count, int dim){
 	FILE *pRead;
-	Point *data = (Point *) malloc(sizeof(Point));
-	float nX, nY;
+	float *data = (float *) calloc((size_t) count * dim, sizeof(float));
+	int i;
 
 	if((pRead = fopen(fileName, "r")) == NULL){
 		printf("Fail to open file: %s", fileName);
 		exit(-1);
 	}
 
-	*count = 0;
-	while(fscanf(pRead, "%f %f\n", &nX, &nY) != EOF){
-		data = (Point *) realloc(data, (*count+1) * sizeof(Point));
-		data[*count].x = nX;
-		data[*count].y = nY;
-		++ *count;
+	for(i = 0; i < count * dim; i++){
+		fscanf(pRead, "%f", &data[i]);
 	}
 	fclose(pRead);
 
@@ -107,156 +183,311 @@ Point *readData(char *fileName, int *count){
 }
 
 /*
- * Reads the centroids from input file
+ * Print a point as one line of dim values
  *
- * This function will change the value of count
+ * @param pWrite	FILE*	the file to write to
+ * @param point		float*	the dim values of the point
+ * @param dim		int		number of dimensions
  *
- * @param fileName	char*	the file path and name to be read
- * @param count		int	number of file lines
+ * @return void
+ */
+void printPoint(FILE *pWrite, float *point, int dim){
+	int t;
+
+	for(t = 0; t < dim; t++){
+		fprintf(pWrite, t ? " %f" : "%f", point[t]);
+	}
+	fprintf(pWrite, "\n");
+}
+
+/*
+ * Print the measures of the last iteration, kept by the rules
  *
- * @return data		Point*	array storing the points
+ * @param c		Convergence*	the rules, after the iteration was checked
  *
+ * @return void
  */
-Point *readCentroids(char *fileName, int count){
-	FILE *pRead;
-	Point *data = (Point *) calloc(count, sizeof(Point));
-	int i;
+void printIteration(Convergence *c){
+	printf("Loop %d: largest shift %.6g, inertia %.6g, %ld labels changed, %.3f s.\n",
+			c->lastLoop, c->lastShift, c->lastInertia, c->lastChanged, c->lastElapsed);
+}
 
-	if((pRead = fopen(fileName, "r")) == NULL){
-		printf("Fail to open file: %s", fileName);
+/*
+ * Read the points of the input file, reporting the time it took, or
+ * stop with an error
+ *
+ * This function will change the value of size and dim
+ *
+ * @param fileName	char*	the file path and name to be read
+ * @param size		int*	number of points
+ * @param dim		int*	number of dimensions
+ *
+ * @return float*	the points, one row of dim values per point, released with freeData
+ */
+float *loadData(char *fileName, int *size, int *dim){
+	struct timespec start, stop;
+	struct stat st;
+	float *data;
+	double seconds;
+	int error, threads = 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if((data = readData(fileName, size, dim, &error)) == NULL){
+		printf("%s: %s\n", loadError(error), fileName);
 		exit(-1);
 	}
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
 
-	for(i = 0; i < count; i++){
-		fscanf(pRead, "%f %f\n", &data[i].x, &data[i].y);
+	if(mappedData(data)){
+		printf("Mapped %d points in %.3f s.\n", *size, seconds);
+	}else{
+		printf("Loaded %d points in %.3f s (%.1f MB/s, %d threads).\n", *size, seconds,
+				stat(fileName, &st) == 0 ? st.st_size / 1e6 / seconds : 0, threads);
 	}
-	fclose(pRead);
 
 	return data;
 }
 
 /*
- * k-means algorithm inplementation
+ * Mini-batch k-means on the context, printing the initial centroids and
+ * the statistics of the run of the library
+ *
+ * This function will change the value of km
+ *
+ * @param km		KMeans*	the context, its centroids set
+ * @param data		float*	the input data, one row of dim values per point
+ * @param size		int		number of points
+ * @param batch		int		number of points per batch
+ * @param batches	int		most batches to run
+ * @param seconds	double	time budget of the batches, 0 for none
+ *
+ * @return int*	the label of each point, held by km
+ */
+int *miniBatch(KMeans *km, float *data, int size, int batch, int batches, double seconds){
+	struct timespec start, stop;
+	int *labels;
+	int i;
+
+	printf("=====initial centroids=====\n");
+	for(i = 0; i < km->k; i++){
+		printPoint(stdout, km->centroids + (size_t) i * km->dim, km->dim);
+	}
+	printf("===========================\n");
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if((labels = miniBatchKMeans(km, data, size, batch, batches, seconds)) == NULL){
+		printf("Unable to allocate the labels of %d points\n", size);
+		exit(-1);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	printf("Ran %d batches of %d points in %.3f s.\n", km->loops, batch,
+			(stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9 - km->assignTime);
+	printf("Spent %.3f s assigning points.\n", km->assignTime);
+	printf("Inertia %.6g.\n", km->inertia);
+
+	return labels;
+}
+
+/*
+ * k-means algorithm inplementation, printing the initial centroids and
+ * the statistics of the run of the library
  *
- * This function will change the value of centroids
+ * This function will change the value of km
  *
- * @param data		Point*		the input data array
+ * @param km		KMeans*		the context, its centroids and options set
+ * @param data		float*		the input data, one row of dim values per point
  * @param size		int			the size of input data
- * @param k			int			k-means
- * @param centroids	Point*		array storing the k centroids
  *
- * @return labels	int*	an array storing the label of each point
+ * @return labels	int*	an array storing the label of each point, held by km
  *
  */
-int *kmeans(Point *data, int size, int k, Point *centroids){
-	int *labels = (int *) calloc(size, sizeof(int));
-	int i, j, done, loops;
-	float minDist, dist;
-	float tempX, tempY;
-	Point *tempC = (Point *) calloc(k, sizeof(Point)); /*temporary centroids*/
-	int *counts = (int *) calloc(k, sizeof(int));	/*counts of each cluster*/
+int *kmeans(KMeans *km, float *data, int size){
+	int *labels;
+	int i;
+
+	printf("=====initial centroids=====\n");
+	for(i = 0; i < km->k; i++){
+		printPoint(stdout, km->centroids + (size_t) i * km->dim, km->dim);
+	}
+	printf("===========================\n");
+
+	if((labels = fitKMeans(km, data, size)) == NULL){
+		printf("Unable to allocate the workspaces of %d points\n", size);
+		exit(-1);
+	}
+
+	printf("Iterated %d loops.\n", km->loops);
+	printf("Stopped as %s.\n", km->stop.reason);
+	printf("Computed %ld distances.\n", km->evals);
+	if(km->delta > 0){
+		printf("Summed all the points in %d of %d loops.\n", km->full, km->loops);
+	}
+	printf("Spent %.3f s assigning points.\n", km->assignTime);
+	printf("Inertia %.6g.\n", km->inertia);
+
+	return labels;
+}
+
+/*
+ * Get the next block of points of the input file, or stop with an error
+ *
+ * This function will change the value of s and block
+ *
+ * @param s			Stream*	the input file
+ * @param block		float**	where to store the block
+ *
+ * @return int	number of points in the block, 0 at the end of the file
+ */
+int streamBlock(Stream *s, float **block){
+	int count;
+
+	if((count = nextBlock(s, block)) < 0){
+		printf("%s: the input file, at point %lu\n", loadError(s->error), (unsigned long) s->next);
+		exit(-1);
+	}
+
+	return count;
+}
+
+/*
+ * Cluster the points of a file block by block, for data larger than the
+ * memory. Every iteration reads the whole file again, the next block
+ * being read while the current one is assigned, and a last pass writes
+ * the labels, so only two blocks and the k centroids are held in memory.
+ * Each block runs through a pass of the context, whose workspaces hold
+ * one block.
+ *
+ * This function will change the value of km
+ *
+ * @param km		KMeans*	the context, its centroids, kernel and rules set, the labels changed excepted
+ * @param s			Stream*	the input file
+ *
+ * @return int	number of points
+ */
+int streamKmeans(KMeans *km, Stream *s){
+	char *outLabelFileName = "labels.txt";
+	FILE *pWrite;
+	int i, count, size = 0, done, k = km->k, dim = km->dim;
+	long evals = 0;	/* number of distances computed */
+	struct timespec start, end;
+	double assignTime = 0, waitTime = 0;	/* seconds spent assigning the points, and waiting for them */
+	double inertia;	/* sum of the squared distances to the centroids */
+	long changed;
+	float *block;
+	double shift;
+	int *labels;
 
 	printf("=====initial centroids=====\n");
 	for(i = 0; i < k; i++){
-		printf("%f %f\n", centroids[i].x, centroids[i].y);
+		printPoint(stdout, km->centroids + (size_t) i * dim, dim);
 	}
 	printf("===========================\n");
 
+	if(!beginKMeans(km, s->blockSize)){
+		printf("Unable to allocate the workspaces of blocks of %d points\n", s->blockSize);
+		exit(-1);
+	}
+	/* the block before held other points, there are no labels to count changes against */
+	free(km->previous);
+	km->previous = NULL;
+
 	/* loop to determine the clusters */
-	done = TRUE;
-	loops = 0;
+	km->loops = 0;
+	startConvergence(&km->stop);
 	do{
-		/* initialize the helper arrays */
-		for(i = 0; i < k; i++){
-			counts[i] = 0;
-			tempC[i].x = 0;
-			tempC[i].y = 0;
-		}
-
-		for(i = 0; i < size; i++){
-			minDist = FLT_MAX;
-			/* compute the distance between the point and each centroid*/
-			for(j = 0; j < k; j++){
-				/* no need to compute the sqrt, we just need the value for comparison */
-				dist = pow(data[i].x - centroids[j].x, 2) +
-						pow(data[i].y - centroids[j].y, 2);
-				if(dist < minDist){
-					minDist = dist;
-					labels[i] = j;
-				}
+		rewindStream(s);
+		size = 0;
+		inertia = 0;
+		changed = 0;
+		startPass(km, TRUE);
+		for(;;){
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			count = streamBlock(s, &block);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			waitTime += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+			if(count == 0){
+				break;
 			}
 
-			++counts[labels[i]];
+			evals += passKMeans(km, block, 0, count);
+			carrySums(km);
+			inertia += km->threadPasses[0].inertia;
+			changed += km->threadPasses[0].changed;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			assignTime += (start.tv_sec - end.tv_sec) + (start.tv_nsec - end.tv_nsec) / 1e9;
 
-			/*
-			 * simply add on the x and y of each point,
-			 * for further computation of new centroid
-			 */
-			tempC[labels[i]].x += data[i].x;
-			tempC[labels[i]].y += data[i].y;
+			size += count;
 		}
 
 		/* update the centroids */
-		done = TRUE;
-		for(i = 0; i < k; i++){
-			tempX = counts[i] ? tempC[i].x / counts[i] : 0;
-			tempY = counts[i] ? tempC[i].y / counts[i] : 0;
-			if(centroids[i].x != tempX || centroids[i].y != tempY){
-				done = FALSE; /* quit the loop until no change */
-				centroids[i].x = tempX;
-				centroids[i].y = tempY;
-			}
-		}
+		shift = updateCentroids(km->totals, km->totalCounts, km->centroids, k, dim);
 
-		++loops;
+		++km->loops;
+		done = converged(&km->stop, km->loops, shift, inertia, changed, size);
+		if(km->stop.verbose){
+			printIteration(&km->stop);
+		}
 	}while(!done);
 
-	printf("Iterated %d loops.\n", loops);
+	printf("Iterated %d loops.\n", km->loops);
+	printf("Stopped as %s.\n", km->stop.reason);
+	printf("Computed %ld distances.\n", evals);
+	printf("Spent %.3f s assigning points.\n", assignTime);
+	printf("Spent %.3f s waiting for blocks of %d points.\n", waitTime, s->blockSize);
 
-	/*  Clean up */
-	free(tempC);
-	free(counts);
+	/* write labels into file, block by block */
+	if((pWrite = fopen(outLabelFileName, "w")) == NULL){
+		printf("Fail to open output file: %s\n", outLabelFileName);
+		exit(-1);
+	}
 
-	return labels;
+	rewindStream(s);
+	inertia = 0;
+	while((count = streamBlock(s, &block)) > 0){
+		if((labels = predictKMeans(km, block, count)) == NULL){
+			printf("Unable to allocate the labels of %d points\n", count);
+			exit(-1);
+		}
+		inertia += computeInertia(block, dim, 0, count, km->centroids, labels);
+		for(i = 0; i < count; i++){
+			fprintf(pWrite, "%d\n", labels[i]);
+		}
+	}
+
+	fclose(pWrite);
+
+	printf("Successfully wrote %d labels into file: %s\n", size, outLabelFileName);
+	printf("Inertia %.6g.\n", inertia);
+
+	return size;
 }
 
 /*
- * Initialize the centroids, randomly select initial points
+ * Initialize the centroids, from the first point of k chunks of the data,
+ * at random coordinates or with k-means++
  *
- * @param data	Point*	array of input points
+ * @param data	float*	the input data, one row of dim values per point
  * @param size	int		number of points
+ * @param dim	int		number of dimensions
  * @param k		int		number of clusters
- * @param r		int		whether create randomly
+ * @param r		int		how to create them, INIT_CHUNKS, INIT_RANDOM or INIT_PLUSPLUS
  *
- * @return Point* array of centroids
+ * @return float* the k centroids, one row of dim values each
  *
  */
-Point *initialCentroids(Point *data, int size, int k, int r){
-	Point *c = (Point *) calloc(k, sizeof(Point));
-	int i,j;
+float *initialCentroids(float *data, int size, int dim, int k, int r){
+	float *c = (float *) calloc((size_t) k * dim, sizeof(float));
+	int i;
 	char *fileName = "initial.txt";
 	FILE *pWrite;
 
+	seedCentroids(data, size, dim, k, r, c);
 	if(k > size){
 		k = size;
 	}
 
-	srand((unsigned) time(NULL));
-	for(i = j = 0; i < k; i++){
-		if(r){
-			c[i].x = (float) (rand() % 1000) / 1000 * 8;
-			c[i].y = (float) (rand() % 1000) / 1000 * 8;
- 		}else{
- 			/*
-			 * pick the first point from k chunks,
-			 * it's not real random, but acceptable
-			 */
-			j += size/k;
-			c[i].x = data[j].x;
-			c[i].y = data[j].y;
- 		}
-	}
-
 	/* write to file */
 	if((pWrite = fopen(fileName, "w")) == NULL){
 		printf("Fail to open output file: %s\n", fileName);
@@ -264,7 +495,7 @@ Point *initialCentroids(Point *data, int size, int k, int r){
 	}
 
 	for(i = 0; i < k; i++){
-		fprintf(pWrite, "%f %f\n", c[i].x, c[i].y);
+		printPoint(pWrite, c + (size_t) i * dim, dim);
 	}
 
 	printf("Successfully wrote initial centroids into file: %s\n", fileName);
@@ -274,19 +505,48 @@ Point *initialCentroids(Point *data, int size, int k, int r){
 	return c;
 }
 
+/*
+ * writes the centroids into centroids.txt
+ *
+ * @param centroids	float*	The k centroids, one row of dim values each
+ * @param k			int		k-means
+ * @param dim		int		number of dimensions
+ *
+ * @return void
+ */
+void writeCentroids(float *centroids, int k, int dim){
+	char *outCntrdFileName = "centroids.txt";
+	FILE *pWrite;
+	int i;
+
+	/* write centroids into file */
+	if((pWrite = fopen(outCntrdFileName, "w")) == NULL){
+		printf("Fail to open output file: %s\n", outCntrdFileName);
+		exit(-1);
+	}
+
+	for(i = 0; i < k; i++){
+		printPoint(pWrite, centroids + (size_t) i * dim, dim);
+	}
+
+	fclose(pWrite);
+
+	printf("Successfully wrote %d centroids into file: %s\n", k, outCntrdFileName);
+}
+
 /*
  * writes the labels and centroids into corresponding files
  *
  * @param labels	int*	The array storing cluster labels for each point
  * @param size		int		The size of data
- * @param centroids	Point*	The array storing k centroids
+ * @param centroids	float*	The k centroids, one row of dim values each
  * @param k			int		k-means
+ * @param dim		int		number of dimensions
  *
  * @return void
  */
-void writeToFile(int *labels, int size, Point *centroids, int k){
+void writeToFile(int *labels, int size, float *centroids, int k, int dim){
 	char *outLabelFileName = "labels.txt";
-	char *outCntrdFileName = "centroids.txt";
 	FILE *pWrite;
 	int i;
 
@@ -304,19 +564,7 @@ void writeToFile(int *labels, int size, Point *centroids, int k){
 
 	printf("Successfully wrote %d labels into file: %s\n", size, outLabelFileName);
 
-	/* write centroids into file */
-	if((pWrite = fopen(outCntrdFileName, "w")) == NULL){
-		printf("Fail to open output file: %s\n", outCntrdFileName);
-		exit(-1);
-	}
-
-	for(i = 0; i < k; i++){
-		fprintf(pWrite, "%f %f\n", centroids[i].x, centroids[i].y);
-	}
-
-	fclose(pWrite);
-
-	printf("Successfully wrote %d centroids into file: %s\n", k, outCntrdFileName);
+	writeCentroids(centroids, k, dim);
 }
 
 /*
@@ -326,43 +574,139 @@ int main(int argc, char **argv){
 
 	char *inputFileName = NULL;
 	char *centFileName = NULL;
+	char *binFileName = NULL;	/* where to convert the input data */
+	int batch = 0;	/* points per batch of mini-batch k-means */
+	int delta = 0;	/* iterations between full sums of the delta updates */
+	Convergence stop;	/* the rules ending the iterations */
+	int blockSize = 0;	/* points per block when streaming */
+	Stream *stream;
 	int size;	/* line count of input data*/
-	Point *data;	/* input data points*/
-	Point *centroids;
+	int dim;	/* number of dimensions */
+	int error;	/* why a data file could not be read or written */
+	float *data;	/* input data points*/
+	float *centroids;
 	int *labels;
+	KMeans *km;	/* the context of the library */
 	int k = 0;
-	int r = FALSE;
+	int r = INIT_CHUNKS;
+	unsigned seed = (unsigned) time(NULL);
+	int a = FALSE;
+	int kernel = KERNEL_AUTO;
+	int picked;	/* the assignment kernel run */
+	int g = FALSE;
 	time_t start, end;
 	start = clock();
 
-	getCmdOptions(argc, argv, &inputFileName, &k, &r, &centFileName);
+	initConvergence(&stop);
+	getCmdOptions(argc, argv, &inputFileName, &k, &r, &seed, &centFileName, &a, &kernel, &g, &binFileName, &blockSize, &batch, &delta, &stop);
+	srand(seed);
+	printf("Random seed %u.\n", seed);
+	picked = supportedKernel(kernel);
+	if(kernel != KERNEL_AUTO && picked != kernel){
+		printf("Kernel %s is not supported by this CPU.\n", kernelName(kernel));
+	}
+	printf("Using %s%s assignment kernel.\n", g ? "generic " : "", kernelName(picked));
+
+	if(blockSize > 0){
+		if((stream = openStream(inputFileName, blockSize, &error)) == NULL){
+			printf("%s: %s\n", loadError(error), inputFileName);
+			exit(-1);
+		}
+		dim = stream->dim;
+		if(a){
+			printf("The bounds of -a take memory for every point, not used when streaming.\n");
+		}
+		if(stop.changed > 0){
+			printf("Counting the labels changed takes memory for every point, -l is not used when streaming.\n");
+			stop.changed = 0;
+		}
+		if(delta > 0){
+			printf("The delta updates of -d take memory for every point, not used when streaming.\n");
+		}
+
+		if(centFileName != NULL){
+			centroids = readCentroids(centFileName, k, dim);
+		}else{
+			/* pick the initial centroids from the first block */
+			size = streamBlock(stream, &data);
+			centroids = initialCentroids(data, size, dim, k, r);
+		}
+
+		if((km = createKMeans(k, dim, 0)) == NULL){
+			printf("Unable to allocate the workspaces of %d clusters\n", k);
+			exit(-1);
+		}
+		km->kernel = picked;
+		km->generic = g;
+		km->stop = stop;
+		memcpy(km->centroids, centroids, (size_t) k * dim * sizeof(float));
+		size = streamKmeans(km, stream);
+		writeCentroids(km->centroids, k, dim);
+		freeKMeans(km);
+		closeStream(stream);
+
+		free(inputFileName);
+		free(centFileName);
+		free(centroids);
 
-	data = readData(inputFileName, &size);
+		end = clock();
+		printf("%d points of %d dimensions assigned to %d clusters in %.2f s.\n", size, dim, k, (double)(end - start)/CLOCKS_PER_SEC);
+
+		return 0;
+	}
+
+	data = loadData(inputFileName, &size, &dim);
+
+	if(binFileName != NULL){
+		if((error = writeBinary(binFileName, data, size, dim)) != LOAD_OK){
+			printf("%s: %s\n", loadError(error), binFileName);
+			exit(-1);
+		}
+		printf("Successfully wrote %d points into file: %s\n", size, binFileName);
+		freeData(data);
+		return 0;
+	}
 
 	if(centFileName != NULL){
-		centroids = readCentroids(centFileName, k);
+		centroids = readCentroids(centFileName, k, dim);
 	}else{
-		centroids = initialCentroids(data, size, k, r);
+		centroids = initialCentroids(data, size, dim, k, r);
 	}
 
-	labels = kmeans(data, size, k, centroids);
+	if((km = createKMeans(k, dim, 0)) == NULL){
+		printf("Unable to allocate the workspaces of %d clusters\n", k);
+		exit(-1);
+	}
+	km->kernel = picked;
+	km->generic = g;
+	memcpy(km->centroids, centroids, (size_t) k * dim * sizeof(float));
+	if(batch > 0){
+		labels = miniBatch(km, data, size, batch, stop.loops > 0 ? stop.loops : DEFAULT_BATCHES, stop.seconds);
+	}else{
+		km->a = a;
+		km->delta = delta;
+		km->stop = stop;
+		km->report = stop.verbose ? printIteration : NULL;
+		labels = kmeans(km, data, size);
+	}
+	memcpy(centroids, km->centroids, (size_t) k * dim * sizeof(float));
 
-	writeToFile(labels, size, centroids, k);
+	writeToFile(labels, size, centroids, k, dim);
+	freeKMeans(km);
 
 	/*  Clean up */
 	free(inputFileName);
 	free(centFileName);
+	free(binFileName);
 
-	if(data){
-		free(data);
-	}
+	freeData(data);
 
 	if(centroids){
 		free(centroids);
 	}
 
 	end = clock();
-	printf("%d points assigned to %d clusters in %.2f s.\n", size, k, (double)(end - start)/CLOCKS_PER_SEC);
+	printf("%d points of %d dimensions assigned to %d clusters in %.2f s.\n", size, dim, k, (double)(end - start)/CLOCKS_PER_SEC);
 
 	return 0;
 }
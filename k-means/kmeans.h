@@ -16,27 +16,41 @@
 #include <float.h>
 #include <math.h>
 #include <time.h>
-
-typedef struct{
-	float x;
-	float y;
-} Point;
+#include <sys/stat.h>
 
 #define TRUE 1
 #define FALSE 0
 
+struct Convergence;	/* see convergence.h */
+
 void help();
 
-void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, char ** centFileName);
+void getCmdOptions(int argc, char **argv, char **inputFileName, int *k, int *r, unsigned *seed, char ** centFileName, int *a, int *kernel, int *g, char **binFileName, int *blockSize, int *batch, int *delta, struct Convergence *stop);
+
+float *readCentroids(char *fileName, int count, int dim);
+
+void printPoint(FILE *pWrite, float *point, int dim);
+
+void printIteration(struct Convergence *c);
+
+float *loadData(char *fileName, int *size, int *dim);
+
+struct KMeans;	/* see libkmeans.h */
+
+int *miniBatch(struct KMeans *km, float *data, int size, int batch, int batches, double seconds);
+
+int *kmeans(struct KMeans *km, float *data, int size);
+
+struct Stream;	/* see loader.h */
 
-Point *readData(char *fileName, int *count);
+int streamBlock(struct Stream *s, float **block);
 
-Point *readCentroids(char *fileName, int count);
+int streamKmeans(struct KMeans *km, struct Stream *s);
 
-int *kmeans(Point *data, int n, int k, Point *centroids);
+float *initialCentroids(float *data, int size, int dim, int k, int r);
 
-Point *initialCentroids(Point *data, int size, int k, int r);
+void writeCentroids(float *centroids, int k, int dim);
 
-void writeToFile(int *labels, int n, Point *centroids, int k);
+void writeToFile(int *labels, int n, float *centroids, int k, int dim);
 
 #endif /* KMEANS_H_ */
@@ -0,0 +1,21 @@
+/*
+ * common.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef COMMON_H_
+#define COMMON_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+
+#define TRUE 1
+#define FALSE 0
+
+#endif /* COMMON_H_ */
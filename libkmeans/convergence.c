@@ -0,0 +1,135 @@
+/*
+ * convergence.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "convergence.h"
+
+/*
+ * Seconds since an arbitrary point, for the time budget
+ *
+ * @return double	the time
+ */
+static double now(){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * Set the rules to iterate until no centroid moves, with no limits
+ *
+ * @param c		Convergence*	the rules
+ *
+ * @return void
+ */
+void initConvergence(Convergence *c){
+	memset(c, 0, sizeof(Convergence));
+	c->lastInertia = -1;
+}
+
+/*
+ * Start the clock of the time budget, before the first iteration
+ *
+ * @param c		Convergence*	the rules
+ *
+ * @return void
+ */
+void startConvergence(Convergence *c){
+	c->start = now();
+	c->lastInertia = -1;
+	c->reason = NULL;
+}
+
+/*
+ * Whether the iterations need to measure the inertia
+ *
+ * @param c		Convergence*	the rules
+ *
+ * @return int	TRUE if so
+ */
+int tracksInertia(Convergence *c){
+	return c->inertia > 0 || c->verbose;
+}
+
+/*
+ * Whether the iterations need to count the labels changed
+ *
+ * @param c		Convergence*	the rules
+ *
+ * @return int	TRUE if so
+ */
+int tracksChanges(Convergence *c){
+	return c->changed > 0 || c->verbose;
+}
+
+/*
+ * Seconds since the iterations started
+ *
+ * @param c		Convergence*	the rules
+ *
+ * @return double	the time
+ */
+double elapsedConvergence(Convergence *c){
+	return now() - c->start;
+}
+
+/*
+ * Check the rules after an iteration, and keep its measures in c
+ *
+ * This function will change the value of c
+ *
+ * @param c			Convergence*	the rules
+ * @param loops		int		number of iterations done
+ * @param shift		double	how far the centroid moving the most moved
+ * @param inertia	double	sum of the squared distances of the points to their centroids
+ * @param changed	long	number of labels changed by the iteration
+ * @param size		long	number of points
+ *
+ * @return int	TRUE if the iterations should stop, c->reason telling why
+ */
+int converged(Convergence *c, int loops, double shift, double inertia, long changed, long size){
+	return convergedAfter(c, loops, shift, inertia, changed, size, elapsedConvergence(c));
+}
+
+/*
+ * Check the rules after an iteration against a given time, so processes
+ * sharing the time of one of them all come to the same decision. The
+ * measures of the iteration are kept in c for the caller to print.
+ *
+ * This function will change the value of c
+ *
+ * @param c			Convergence*	the rules
+ * @param loops		int		number of iterations done
+ * @param shift		double	how far the centroid moving the most moved
+ * @param inertia	double	sum of the squared distances of the points to their centroids
+ * @param changed	long	number of labels changed by the iteration
+ * @param size		long	number of points
+ * @param elapsed	double	seconds since the iterations started
+ *
+ * @return int	TRUE if the iterations should stop, c->reason telling why
+ */
+int convergedAfter(Convergence *c, int loops, double shift, double inertia, long changed, long size, double elapsed){
+	c->reason = NULL;
+	if(shift <= c->shift){
+		c->reason = c->shift > 0 ? "no centroid moved further than the tolerance" : "no centroid moved";
+	}else if(c->inertia > 0 && c->lastInertia >= 0 && fabs(c->lastInertia - inertia) <= c->inertia * inertia){
+		c->reason = "the inertia changed less than the tolerance";
+	}else if(c->changed > 0 && changed <= c->changed * size){
+		c->reason = "fewer labels changed than the tolerance";
+	}else if(c->loops > 0 && loops >= c->loops){
+		c->reason = "the iteration limit was reached";
+	}else if(c->seconds > 0 && elapsed >= c->seconds){
+		c->reason = "the time budget was spent";
+	}
+	c->lastLoop = loops;
+	c->lastShift = shift;
+	c->lastInertia = inertia;
+	c->lastChanged = changed;
+	c->lastElapsed = elapsed;
+
+	return c->reason != NULL;
+}
@@ -0,0 +1,46 @@
+/*
+ * convergence.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef CONVERGENCE_H_
+#define CONVERGENCE_H_
+
+#include "common.h"
+
+/*
+ * The rules ending the iterations, the first one met stops them.
+ * Without any, the iterations run until no centroid moves.
+ */
+typedef struct Convergence{
+	double shift;		/* stop once no centroid moves further than this */
+	double inertia;		/* stop once the inertia changes by less than this fraction, 0 for never */
+	double changed;		/* stop once fewer than this fraction of labels change, 0 for never */
+	int loops;			/* most iterations, 0 for no limit */
+	double seconds;		/* most seconds, 0 for no limit */
+	int verbose;		/* whether measure every iteration, for the caller to print */
+	double start;		/* when the iterations started */
+	int lastLoop;		/* number of iterations checked */
+	double lastShift;	/* how far the centroid moving the most moved in the last iteration */
+	double lastInertia;	/* inertia of the last iteration, negative before the first */
+	long lastChanged;	/* number of labels changed by the last iteration */
+	double lastElapsed;	/* seconds from the start to the end of the last iteration */
+	char *reason;		/* the rule which stopped the iterations */
+} Convergence;
+
+void initConvergence(Convergence *c);
+
+void startConvergence(Convergence *c);
+
+int tracksInertia(Convergence *c);
+
+int tracksChanges(Convergence *c);
+
+double elapsedConvergence(Convergence *c);
+
+int converged(Convergence *c, int loops, double shift, double inertia, long changed, long size);
+
+int convergedAfter(Convergence *c, int loops, double shift, double inertia, long changed, long size, double elapsed);
+
+#endif /* CONVERGENCE_H_ */
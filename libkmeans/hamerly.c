@@ -0,0 +1,272 @@
+/*
+ * hamerly.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "hamerly.h"
+
+/* round the distances like the assignment kernels, see kernels.c */
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+/*
+ * Relative margin a bound must win by before a point is skipped.
+ * The assignment kernels compare squared distances rounded to float,
+ * so near ties always fall through to the full scan and the labels
+ * stay identical to the ones they would produce.
+ */
+#define BOUND_GUARD 1e-6
+
+/*
+ * Squared distance between two points, rounded exactly the way the
+ * assignment kernels round it
+ */
+static float squareDist(float *a, float *b, int dim){
+	int t;
+	float diff, dist = 0;
+
+	for(t = 0; t < dim; t++){
+		diff = a[t] - b[t];
+		dist += diff * diff;
+	}
+
+	return dist;
+}
+
+/*
+ * Euclidean distance between two points in double precision,
+ * used for the centroid moves so the bounds stay conservative
+ */
+static double exactDist(float *a, float *b, int dim){
+	int t;
+	double diff, dist = 0;
+
+	for(t = 0; t < dim; t++){
+		diff = (double) a[t] - b[t];
+		dist += diff * diff;
+	}
+
+	return sqrt(dist);
+}
+
+/*
+ * Allocate the bounds for size points and k centroids
+ *
+ * The upper bounds start at infinity and the lower bounds at zero,
+ * so every point gets a full scan in the first iteration.
+ *
+ * @param size	int		number of points
+ * @param dim	int		number of dimensions
+ * @param k		int		number of clusters
+ *
+ * @return Bounds*	the allocated bounds, NULL if the memory is short
+ */
+Bounds *createBounds(int size, int dim, int k){
+	Bounds *b = (Bounds *) malloc(sizeof(Bounds));
+
+	if(b == NULL){
+		return NULL;
+	}
+	b->dim = dim;
+	b->upper = (double *) malloc(size * sizeof(double));
+	b->lower = (double *) calloc(size, sizeof(double));
+	b->s = (double *) calloc(k, sizeof(double));
+	b->drift = (double *) calloc(k, sizeof(double));
+	b->old = (float *) calloc((size_t) k * dim, sizeof(float));
+	if(b->upper == NULL || b->lower == NULL || b->s == NULL || b->drift == NULL || b->old == NULL){
+		freeBounds(b);
+		return NULL;
+	}
+
+	resetBounds(b, size);
+
+	return b;
+}
+
+/*
+ * Forget the bounds of the first points, so their next assignment
+ * computes every distance
+ *
+ * This function will change the value of b
+ *
+ * @param b		Bounds*	the bounds
+ * @param size	int		number of points
+ *
+ * @return void
+ */
+void resetBounds(Bounds *b, int size){
+	int i;
+
+	for(i = 0; i < size; i++){
+		b->upper[i] = DBL_MAX;
+		b->lower[i] = 0;
+	}
+}
+
+/*
+ * Free the bounds
+ *
+ * @param b	Bounds*	the bounds to be freed
+ *
+ * @return void
+ */
+void freeBounds(Bounds *b){
+	if(b){
+		free(b->upper);
+		free(b->lower);
+		free(b->s);
+		free(b->drift);
+		free(b->old);
+		free(b);
+	}
+}
+
+/*
+ * Compute half of the distance from each centroid to its closest one,
+ * a point closer than that to its centroid can't be closer to any other
+ *
+ * @param b			Bounds*	the bounds
+ * @param centroids	float*	the k centroids, one row of dim values each
+ * @param k			int		k-means
+ *
+ * @return void
+ */
+void centroidSeparation(Bounds *b, float *centroids, int k){
+	int i, j;
+	double dist;
+
+	for(i = 0; i < k; i++){
+		b->s[i] = DBL_MAX;
+	}
+
+	for(i = 0; i < k; i++){
+		for(j = i + 1; j < k; j++){
+			dist = exactDist(centroids + (size_t) i * b->dim, centroids + (size_t) j * b->dim, b->dim) / 2;
+			if(dist < b->s[i]){
+				b->s[i] = dist;
+			}
+			if(dist < b->s[j]){
+				b->s[j] = dist;
+			}
+		}
+	}
+}
+
+/*
+ * Assign the i-th point to its closest centroid, skipping the scan
+ * over all centroids whenever the bounds prove the label can't change
+ *
+ * This function will change the value of labels[i] and the bounds of the point
+ *
+ * @param b			Bounds*	the bounds
+ * @param data		float*	the input data, one row of dim values per point
+ * @param i			int		index of the point
+ * @param centroids	float*	the k centroids, one row of dim values each
+ * @param k			int		k-means
+ * @param labels	int*	an array storing the label of each point
+ *
+ * @return int	number of distances computed
+ */
+int assignHamerly(Bounds *b, float *data, int i, float *centroids, int k, int *labels){
+	int j, label, second;
+	float *point = data + (size_t) i * b->dim;
+	double m;
+	float minDist, secondDist, dist;
+
+	label = labels[i];
+	m = b->s[label] > b->lower[i] ? b->s[label] : b->lower[i];
+	if(b->upper[i] * (1 + BOUND_GUARD) < m){
+		return 0;
+	}
+
+	/* tighten the upper bound and test again */
+	b->upper[i] = exactDist(point, centroids + (size_t) label * b->dim, b->dim);
+	if(b->upper[i] * (1 + BOUND_GUARD) < m){
+		return 1;
+	}
+
+	/* bounds failed, compute the distance to each centroid */
+	minDist = secondDist = FLT_MAX;
+	second = label;
+	for(j = 0; j < k; j++){
+		dist = squareDist(point, centroids + (size_t) j * b->dim, b->dim);
+		if(dist < minDist){
+			secondDist = minDist;
+			second = label;
+			minDist = dist;
+			label = j;
+		}else if(dist < secondDist){
+			secondDist = dist;
+			second = j;
+		}
+	}
+
+	labels[i] = label;
+	b->upper[i] = exactDist(point, centroids + (size_t) label * b->dim, b->dim);
+	b->lower[i] = k > 1 ? exactDist(point, centroids + (size_t) second * b->dim, b->dim) : DBL_MAX;
+
+	return k + 1;
+}
+
+/*
+ * Keep a copy of the centroids before they are updated
+ *
+ * @param b			Bounds*	the bounds
+ * @param centroids	float*	the k centroids, one row of dim values each
+ * @param k			int		k-means
+ *
+ * @return void
+ */
+void saveCentroids(Bounds *b, float *centroids, int k){
+	memcpy(b->old, centroids, (size_t) k * b->dim * sizeof(float));
+}
+
+/*
+ * Measure how far each centroid moved in the last update,
+ * must be called after the centroids are updated
+ *
+ * @param b			Bounds*	the bounds
+ * @param centroids	float*	the k updated centroids, one row of dim values each
+ * @param k			int		k-means
+ *
+ * @return void
+ */
+void centroidDrift(Bounds *b, float *centroids, int k){
+	int j;
+
+	/* find the two centroids moving the most */
+	b->far = 0;
+	b->maxDrift = b->secondDrift = 0;
+	for(j = 0; j < k; j++){
+		b->drift[j] = exactDist(b->old + (size_t) j * b->dim, centroids + (size_t) j * b->dim, b->dim);
+		if(b->drift[j] > b->maxDrift){
+			b->secondDrift = b->maxDrift;
+			b->maxDrift = b->drift[j];
+			b->far = j;
+		}else if(b->drift[j] > b->secondDrift){
+			b->secondDrift = b->drift[j];
+		}
+	}
+}
+
+/*
+ * Loosen the bounds of the i-th point by how far the centroids moved,
+ * must be called after centroidDrift()
+ *
+ * @param b			Bounds*	the bounds
+ * @param i			int		index of the point
+ * @param labels	int*	an array storing the label of each point
+ *
+ * @return void
+ */
+void updateBounds(Bounds *b, int i, int *labels){
+	if(b->upper[i] == DBL_MAX){
+		return;
+	}
+	b->upper[i] += b->drift[labels[i]];
+	b->lower[i] -= labels[i] == b->far ? b->secondDrift : b->maxDrift;
+}
@@ -0,0 +1,43 @@
+/*
+ * hamerly.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HAMERLY_H_
+#define HAMERLY_H_
+
+#include "common.h"
+
+/*
+ * Per-point bounds used to skip distance computations, see hamerly.c
+ */
+typedef struct Bounds{
+	int dim;		/* number of dimensions */
+	double *upper;	/* upper bound of the distance to the assigned centroid */
+	double *lower;	/* lower bound of the distance to the second closest centroid */
+	double *s;		/* half of the distance from each centroid to its closest one */
+	double *drift;	/* how far each centroid moved in the last update */
+	float *old;		/* centroids before the last update */
+	int far;		/* the centroid moving the most */
+	double maxDrift;	/* how far the centroid moving the most moved */
+	double secondDrift;	/* how far the centroid moving the second most moved */
+} Bounds;
+
+Bounds *createBounds(int size, int dim, int k);
+
+void resetBounds(Bounds *b, int size);
+
+void freeBounds(Bounds *b);
+
+void centroidSeparation(Bounds *b, float *centroids, int k);
+
+int assignHamerly(Bounds *b, float *data, int i, float *centroids, int k, int *labels);
+
+void saveCentroids(Bounds *b, float *centroids, int k);
+
+void centroidDrift(Bounds *b, float *centroids, int k);
+
+void updateBounds(Bounds *b, int i, int *labels);
+
+#endif /* HAMERLY_H_ */
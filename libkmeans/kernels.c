@@ -0,0 +1,561 @@
+/*
+ * kernels.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/*
+ * Keep the multiply and the add of each squared difference apart, so
+ * every kernel rounds the distances exactly like the scalar one does
+ * even when the instruction set has fused multiply-add
+ */
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+/* tiles are aligned for the widest vector loads */
+#define TILE_ALIGN 64
+
+/* names of the kernels, indexed by the KERNEL_* constants */
+static const char *kernelNames[] = {"scalar", "sse4", "avx2", "avx512"};
+
+/*
+ * The kernels are written once as always inlined bodies taking the
+ * dimension as a parameter. The generic kernels pass it through, the
+ * specialized ones pass a constant so the compiler can fully unroll
+ * the loops over the dimensions and keep the tile in registers.
+ */
+#define INLINE __attribute__((always_inline)) static inline
+
+/*
+ * Instantiate a kernel body for a fixed dimension
+ */
+#define SPECIALIZE(NAME, BODY, TARGET, DIM) \
+	TARGET static int NAME##DIM(float *data, int dim, int from, int to, float *centroids, int k, int *labels, float *tile){ \
+		return BODY(data, DIM, from, to, centroids, k, labels, tile); \
+	}
+
+/*
+ * Instantiate a kernel body for every specialized dimension,
+ * must be kept in sync with specializedDims
+ */
+#define SPECIALIZE_ALL(NAME, BODY, TARGET) \
+	SPECIALIZE(NAME, BODY, TARGET, 2) \
+	SPECIALIZE(NAME, BODY, TARGET, 3) \
+	SPECIALIZE(NAME, BODY, TARGET, 4) \
+	SPECIALIZE(NAME, BODY, TARGET, 8) \
+	SPECIALIZE(NAME, BODY, TARGET, 16) \
+	SPECIALIZE(NAME, BODY, TARGET, 32) \
+	TARGET static int NAME(float *data, int dim, int from, int to, float *centroids, int k, int *labels, float *tile){ \
+		return BODY(data, dim, from, to, centroids, k, labels, tile); \
+	}
+
+/* the table of one instruction set, in the order of specializedDims */
+#define SPECIALIZED(NAME) {NAME##2, NAME##3, NAME##4, NAME##8, NAME##16, NAME##32}
+
+/* number of tiles a kernel keeps in flight, so the comparisons of
+ * one tile overlap with the distance computations of the others */
+#define TILES 4
+
+/* fully unroll the loops over the tiles, so they live in registers */
+#define UNROLL _Pragma("GCC unroll 4")
+
+/* the dimensions with a specialized kernel */
+static const int specializedDims[] = {2, 3, 4, 8, 16, 32};
+#define SPECIALIZED_COUNT 6
+
+/*
+ * Assign the points in [from, to) one by one
+ */
+INLINE int assignScalarBody(float *data, int dim, int from, int to, float *centroids, int k, int *labels, float *tile){
+	int i, j, t;
+	float *point, *centroid;
+	float diff, dist, minDist;
+
+	for(i = from; i < to; i++){
+		point = data + (size_t) i * dim;
+		minDist = FLT_MAX;
+		for(j = 0; j < k; j++){
+			/* no need to compute the sqrt, we just need the value for comparison */
+			centroid = centroids + (size_t) j * dim;
+			dist = 0;
+			for(t = 0; t < dim; t++){
+				diff = point[t] - centroid[t];
+				dist += diff * diff;
+			}
+			if(dist < minDist){
+				minDist = dist;
+				labels[i] = j;
+			}
+		}
+	}
+
+	return i;
+}
+SPECIALIZE_ALL(assignScalar, assignScalarBody, )
+
+#ifdef X86_KERNELS
+/*
+ * Transpose the width points starting at i into the tile, so that
+ * the same dimension of consecutive points can be loaded at once
+ */
+INLINE void packTile(float *data, int dim, int i, int width, float *tile){
+	int l, t;
+	float *point = data + (size_t) i * dim;
+
+	for(l = 0; l < width; l++){
+		for(t = 0; t < dim; t++){
+			tile[t * width + l] = point[t];
+		}
+		point += dim;
+	}
+}
+
+/*
+ * Assign 4 tiles of 4 points, the centroids are broadcast one by one
+ * and each lane keeps its own minimum and label
+ */
+__attribute__((target("sse4.1")))
+INLINE int assignSSE4Body(float *data, int dim, int from, int to, float *centroids, int k, int *labels, float *tile){
+	int i, j, t, u;
+	float *centroid;
+	__m128 diff, c, dist[TILES], minDist[TILES], closer;
+	__m128i label[TILES], index, one;
+
+	one = _mm_set1_epi32(1);
+	for(i = from; i + 4 * TILES <= to; i += 4 * TILES){
+		packTile(data, dim, i, 4 * TILES, tile);
+		UNROLL
+		for(u = 0; u < TILES; u++){
+			minDist[u] = _mm_set1_ps(FLT_MAX);
+			label[u] = _mm_setzero_si128();
+		}
+		index = _mm_setzero_si128();
+		for(j = 0; j < k; j++){
+			centroid = centroids + (size_t) j * dim;
+			UNROLL
+			for(u = 0; u < TILES; u++){
+				dist[u] = _mm_setzero_ps();
+			}
+			for(t = 0; t < dim; t++){
+				c = _mm_set1_ps(centroid[t]);
+				UNROLL
+				for(u = 0; u < TILES; u++){
+					diff = _mm_sub_ps(_mm_load_ps(tile + (t * TILES + u) * 4), c);
+					dist[u] = _mm_add_ps(dist[u], _mm_mul_ps(diff, diff));
+				}
+			}
+			UNROLL
+			for(u = 0; u < TILES; u++){
+				closer = _mm_cmplt_ps(dist[u], minDist[u]);
+				minDist[u] = _mm_blendv_ps(minDist[u], dist[u], closer);
+				label[u] = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(label[u]),
+						_mm_castsi128_ps(index), closer));
+			}
+			index = _mm_add_epi32(index, one);
+		}
+		UNROLL
+		for(u = 0; u < TILES; u++){
+			_mm_storeu_si128((__m128i *) (labels + i + u * 4), label[u]);
+		}
+	}
+
+	return i;
+}
+SPECIALIZE_ALL(assignSSE4, assignSSE4Body, __attribute__((target("sse4.1"))))
+
+/*
+ * Assign 4 tiles of 8 points, same scheme as assignSSE4Body()
+ */
+__attribute__((target("avx2")))
+INLINE int assignAVX2Body(float *data, int dim, int from, int to, float *centroids, int k, int *labels, float *tile){
+	int i, j, t, u;
+	float *centroid;
+	__m256 diff, c, dist[TILES], minDist[TILES], closer;
+	__m256i label[TILES], index, one;
+
+	one = _mm256_set1_epi32(1);
+	for(i = from; i + 8 * TILES <= to; i += 8 * TILES){
+		packTile(data, dim, i, 8 * TILES, tile);
+		UNROLL
+		for(u = 0; u < TILES; u++){
+			minDist[u] = _mm256_set1_ps(FLT_MAX);
+			label[u] = _mm256_setzero_si256();
+		}
+		index = _mm256_setzero_si256();
+		for(j = 0; j < k; j++){
+			centroid = centroids + (size_t) j * dim;
+			UNROLL
+			for(u = 0; u < TILES; u++){
+				dist[u] = _mm256_setzero_ps();
+			}
+			for(t = 0; t < dim; t++){
+				c = _mm256_set1_ps(centroid[t]);
+				UNROLL
+				for(u = 0; u < TILES; u++){
+					diff = _mm256_sub_ps(_mm256_load_ps(tile + (t * TILES + u) * 8), c);
+					dist[u] = _mm256_add_ps(dist[u], _mm256_mul_ps(diff, diff));
+				}
+			}
+			UNROLL
+			for(u = 0; u < TILES; u++){
+				closer = _mm256_cmp_ps(dist[u], minDist[u], _CMP_LT_OQ);
+				minDist[u] = _mm256_blendv_ps(minDist[u], dist[u], closer);
+				label[u] = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(label[u]),
+						_mm256_castsi256_ps(index), closer));
+			}
+			index = _mm256_add_epi32(index, one);
+		}
+		UNROLL
+		for(u = 0; u < TILES; u++){
+			_mm256_storeu_si256((__m256i *) (labels + i + u * 8), label[u]);
+		}
+	}
+
+	return i;
+}
+SPECIALIZE_ALL(assignAVX2, assignAVX2Body, __attribute__((target("avx2"))))
+
+/*
+ * Assign 4 tiles of 16 points, the comparison goes to a mask register
+ */
+__attribute__((target("avx512f")))
+INLINE int assignAVX512Body(float *data, int dim, int from, int to, float *centroids, int k, int *labels, float *tile){
+	int i, j, t, u;
+	float *centroid;
+	__m512 diff, c, dist[TILES], minDist[TILES];
+	__m512i label[TILES], index;
+	__mmask16 closer;
+
+	for(i = from; i + 16 * TILES <= to; i += 16 * TILES){
+		packTile(data, dim, i, 16 * TILES, tile);
+		UNROLL
+		for(u = 0; u < TILES; u++){
+			minDist[u] = _mm512_set1_ps(FLT_MAX);
+			label[u] = _mm512_setzero_si512();
+		}
+		for(j = 0; j < k; j++){
+			centroid = centroids + (size_t) j * dim;
+			UNROLL
+			for(u = 0; u < TILES; u++){
+				dist[u] = _mm512_setzero_ps();
+			}
+			for(t = 0; t < dim; t++){
+				c = _mm512_set1_ps(centroid[t]);
+				UNROLL
+				for(u = 0; u < TILES; u++){
+					diff = _mm512_sub_ps(_mm512_load_ps(tile + (t * TILES + u) * 16), c);
+					dist[u] = _mm512_add_ps(dist[u], _mm512_mul_ps(diff, diff));
+				}
+			}
+			index = _mm512_set1_epi32(j);
+			UNROLL
+			for(u = 0; u < TILES; u++){
+				closer = _mm512_cmp_ps_mask(dist[u], minDist[u], _CMP_LT_OQ);
+				minDist[u] = _mm512_mask_mov_ps(minDist[u], closer, dist[u]);
+				label[u] = _mm512_mask_mov_epi32(label[u], closer, index);
+			}
+		}
+		UNROLL
+		for(u = 0; u < TILES; u++){
+			_mm512_storeu_si512((void *) (labels + i + u * 16), label[u]);
+		}
+	}
+
+	return i;
+}
+SPECIALIZE_ALL(assignAVX512, assignAVX512Body, __attribute__((target("avx512f"))))
+#endif
+
+/* the generic kernels, indexed by the KERNEL_* constants */
+static AssignKernel genericKernels[KERNEL_COUNT] = {
+	assignScalar,
+#ifdef X86_KERNELS
+	assignSSE4, assignAVX2, assignAVX512
+#endif
+};
+
+/* the specialized kernels, indexed by the KERNEL_* constants and specializedDims */
+static AssignKernel specializedKernels[KERNEL_COUNT][SPECIALIZED_COUNT] = {
+	SPECIALIZED(assignScalar),
+#ifdef X86_KERNELS
+	SPECIALIZED(assignSSE4), SPECIALIZED(assignAVX2), SPECIALIZED(assignAVX512)
+#endif
+};
+
+/*
+ * Find the kernel with the given name
+ *
+ * @param name	char*	name of the kernel
+ *
+ * @return int	one of the KERNEL_* constants, KERNEL_AUTO if the name is unknown
+ */
+int kernelByName(char *name){
+	int i;
+
+	for(i = 0; i < KERNEL_COUNT; i++){
+		if(strcmp(name, kernelNames[i]) == 0){
+			return i;
+		}
+	}
+
+	return KERNEL_AUTO;
+}
+
+/*
+ * Name a kernel
+ *
+ * @param kernel	int		one of the KERNEL_* constants
+ *
+ * @return const char*	the name of the kernel, "auto" for KERNEL_AUTO, "unknown" for any other value
+ */
+const char *kernelName(int kernel){
+	if(kernel == KERNEL_AUTO){
+		return "auto";
+	}
+	if(kernel < 0 || kernel >= KERNEL_COUNT){
+		return "unknown";
+	}
+
+	return kernelNames[kernel];
+}
+
+/*
+ * Find the best kernel the host supports by querying cpuid
+ *
+ * @return int	one of the KERNEL_* constants
+ */
+static int bestKernel(){
+#ifdef X86_KERNELS
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")){
+		return KERNEL_AVX512;
+	}
+	if(__builtin_cpu_supports("avx2")){
+		return KERNEL_AVX2;
+	}
+	if(__builtin_cpu_supports("sse4.1")){
+		return KERNEL_SSE4;
+	}
+#endif
+	return KERNEL_SCALAR;
+}
+
+/*
+ * Find the kernel to run for the one requested: the requested kernel if
+ * the host supports it, otherwise the best supported one
+ *
+ * @param kernel	int		one of the KERNEL_* constants, KERNEL_AUTO for the best
+ *
+ * @return int	the kernel to run
+ */
+int supportedKernel(int kernel){
+	int best = bestKernel();
+
+	return kernel == KERNEL_AUTO || kernel > best ? best : kernel;
+}
+
+/*
+ * Find the kernel for points of the given dimension
+ *
+ * @param kernel	int		one of the KERNEL_* constants the host supports
+ * @param generic	int		whether use the generic kernel for every dimension
+ * @param dim		int		number of dimensions
+ *
+ * @return AssignKernel	the specialized kernel if there is one, the generic one otherwise
+ */
+static AssignKernel kernelFor(int kernel, int generic, int dim){
+	int i;
+
+	for(i = 0; !generic && i < SPECIALIZED_COUNT; i++){
+		if(specializedDims[i] == dim){
+			return specializedKernels[kernel][i];
+		}
+	}
+
+	return genericKernels[kernel];
+}
+
+/*
+ * Allocate a scratch tile for assignWith, aligned for the kernels,
+ * to be freed with free()
+ *
+ * @param dim	int		number of dimensions
+ *
+ * @return float*	the tile, NULL if it could not be allocated
+ */
+float *createTile(int dim){
+	float *tile;
+
+	if(posix_memalign((void **) &tile, TILE_ALIGN, (size_t) dim * TILE_WIDTH * sizeof(float))){
+		return NULL;
+	}
+
+	return tile;
+}
+
+/*
+ * Assign each point in [from, to) to its closest centroid with the given
+ * kernel, the specialized one for the dimension of the points if any
+ *
+ * This function will change the value of labels and tile
+ *
+ * @param kernel	int		one of the KERNEL_* constants the host supports, see supportedKernel()
+ * @param generic	int		whether use the generic kernel for every dimension
+ * @param data		float*	the input data, one row of dim values per point
+ * @param dim		int		number of dimensions
+ * @param from		int		index of the first point
+ * @param to		int		index after the last point
+ * @param centroids	float*	the k centroids, one row of dim values each
+ * @param k			int		k-means
+ * @param labels	int*	an array storing the label of each point
+ * @param tile		float*	a scratch tile from createTile, not shared with other threads
+ *
+ * @return void
+ */
+void assignWith(int kernel, int generic, float *data, int dim, int from, int to, float *centroids, int k, int *labels, float *tile){
+	from = kernelFor(kernel, generic, dim)(data, dim, from, to, centroids, k, labels, tile);
+
+	/* the remaining points */
+	assignScalar(data, dim, from, to, centroids, k, labels, tile);
+}
+
+/*
+ * Add each point in [from, to) to the sum and the count of its cluster,
+ * and measure the pass if asked to, see PassStats
+ *
+ * This function will change the value of sums, counts and stats
+ *
+ * @param data		float*	the input data, one row of dim values per point
+ * @param dim		int		number of dimensions
+ * @param from		int		index of the first point
+ * @param to		int		index after the last point
+ * @param labels	int*	an array storing the label of each point
+ * @param sums		float*	the sums of each cluster, one row of dim values each
+ * @param counts	int*	the number of points of each cluster
+ * @param stats		PassStats*	what to measure besides, NULL for nothing
+ *
+ * @return void
+ */
+void accumulatePoints(float *data, int dim, int from, int to, int *labels, float *sums, int *counts, PassStats *stats){
+	int i, t;
+	float *point, *sum, *centroid;
+	double diff;
+
+	for(i = from; i < to; i++){
+		++counts[labels[i]];
+
+		/*
+		 * simply add on the values of each point,
+		 * for further computation of new centroid
+		 */
+		point = data + (size_t) i * dim;
+		sum = sums + (size_t) labels[i] * dim;
+		for(t = 0; t < dim; t++){
+			sum[t] += point[t];
+		}
+
+		if(stats == NULL){
+			continue;
+		}
+		if(stats->centroids != NULL){
+			centroid = stats->centroids + (size_t) labels[i] * dim;
+			for(t = 0; t < dim; t++){
+				diff = (double) point[t] - centroid[t];
+				stats->inertia += diff * diff;
+			}
+		}
+		if(stats->previous != NULL && stats->previous[i] != labels[i]){
+			stats->previous[i] = labels[i];
+			++stats->changed;
+		}
+	}
+}
+
+/*
+ * Move each point in [from, to) whose label changed out of the sum and
+ * the count of its previous cluster into those of its new one, so sums
+ * kept from the last pass follow the labels without adding up every point
+ *
+ * This function will change the value of previous, sums and counts
+ *
+ * @param data		float*	the input data, one row of dim values per point
+ * @param dim		int		number of dimensions
+ * @param from		int		index of the first point
+ * @param to		int		index after the last point
+ * @param labels	int*	an array storing the label of each point
+ * @param previous	int*	the labels the sums hold the points under, -1 for none
+ * @param sums		float*	the sums of each cluster, one row of dim values each
+ * @param counts	int*	the number of points of each cluster
+ *
+ * @return long	number of points moved
+ */
+long movePoints(float *data, int dim, int from, int to, int *labels, int *previous, float *sums, int *counts){
+	int i, t;
+	float *point, *sum;
+	long moved = 0;
+
+	for(i = from; i < to; i++){
+		if(previous[i] == labels[i]){
+			continue;
+		}
+
+		point = data + (size_t) i * dim;
+		if(previous[i] >= 0){
+			--counts[previous[i]];
+			sum = sums + (size_t) previous[i] * dim;
+			for(t = 0; t < dim; t++){
+				sum[t] -= point[t];
+			}
+		}
+		++counts[labels[i]];
+		sum = sums + (size_t) labels[i] * dim;
+		for(t = 0; t < dim; t++){
+			sum[t] += point[t];
+		}
+
+		previous[i] = labels[i];
+		++moved;
+	}
+
+	return moved;
+}
+
+/*
+ * Sum up the squared distance of each point in [from, to) to the
+ * centroid of its cluster
+ *
+ * @param data		float*	the input data, one row of dim values per point
+ * @param dim		int		number of dimensions
+ * @param from		int		index of the first point
+ * @param to		int		index after the last point
+ * @param centroids	float*	the k centroids, one row of dim values each
+ * @param labels	int*	an array storing the label of each point
+ *
+ * @return double	the sum of the squared distances
+ */
+double computeInertia(float *data, int dim, int from, int to, float *centroids, int *labels){
+	int i, t;
+	float *point, *centroid;
+	double diff, sum = 0;
+
+	for(i = from; i < to; i++){
+		point = data + (size_t) i * dim;
+		centroid = centroids + (size_t) labels[i] * dim;
+		for(t = 0; t < dim; t++){
+			diff = (double) point[t] - centroid[t];
+			sum += diff * diff;
+		}
+	}
+
+	return sum;
+}
@@ -0,0 +1,61 @@
+/*
+ * kernels.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+#include "common.h"
+
+/* the assignment kernels, from the slowest to the fastest */
+#define KERNEL_AUTO -1
+#define KERNEL_SCALAR 0
+#define KERNEL_SSE4 1
+#define KERNEL_AVX2 2
+#define KERNEL_AVX512 3
+#define KERNEL_COUNT 4
+
+/*
+ * Assign the points in [from, to) to their closest centroids,
+ * returns the index of the first point left to the scalar loop
+ *
+ * The kernels work on tiles of as many points as they have lanes,
+ * tile is a scratch buffer for the tiles stored dimension by dimension
+ */
+typedef int (*AssignKernel)(float *data, int dim, int from, int to, float *centroids, int k, int *labels, float *tile);
+
+/* number of points a thread hands to the kernels at a time */
+#define ASSIGN_BLOCK 1024
+
+/* the most points a kernel packs at a time */
+#define TILE_WIDTH 64
+
+/*
+ * What accumulatePoints measures besides the sums, each only if asked for
+ */
+typedef struct PassStats{
+	float *centroids;	/* the centroids the points were assigned to, NULL to skip the inertia */
+	int *previous;		/* the labels of the last pass, NULL to skip counting changes, updated */
+	double inertia;		/* sum of the squared distances to the centroids */
+	long changed;		/* number of labels changed since the last pass */
+} PassStats;
+
+int kernelByName(char *name);
+
+const char *kernelName(int kernel);
+
+int supportedKernel(int kernel);
+
+float *createTile(int dim);
+
+void assignWith(int kernel, int generic, float *data, int dim, int from, int to, float *centroids, int k, int *labels, float *tile);
+
+void accumulatePoints(float *data, int dim, int from, int to, int *labels, float *sums, int *counts, PassStats *stats);
+
+long movePoints(float *data, int dim, int from, int to, int *labels, int *previous, float *sums, int *counts);
+
+double computeInertia(float *data, int dim, int from, int to, float *centroids, int *labels);
+
+#endif /* KERNELS_H_ */
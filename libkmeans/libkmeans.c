@@ -0,0 +1,577 @@
+/*
+ * libkmeans.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "libkmeans.h"
+#include "kernels.h"
+#include "seeding.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * The passes over the points are split among the threads of the OpenMP
+ * build, one team running all the iterations of a fit, the other builds
+ * run them in one go
+ */
+#ifdef _OPENMP
+#define PARALLEL_RUN _Pragma("omp parallel num_threads(km->slabs)")
+#define FOR_BLOCKS _Pragma("omp for schedule(static) nowait")
+#define BARRIER _Pragma("omp barrier")
+#define SINGLE _Pragma("omp single")
+#define PARALLEL_BLOCKS _Pragma("omp parallel for schedule(static) num_threads(km->slabs)")
+#define PARALLEL_INERTIA _Pragma("omp parallel for schedule(static) reduction(+:inertia) num_threads(km->slabs)")
+#define THREAD_ID omp_get_thread_num()
+#define TEAM_SIZE omp_get_num_threads()
+#else
+#define PARALLEL_RUN
+#define FOR_BLOCKS
+#define BARRIER
+#define SINGLE
+#define PARALLEL_BLOCKS
+#define PARALLEL_INERTIA
+#define THREAD_ID 0
+#define TEAM_SIZE 1
+#endif
+
+/*
+ * Seconds since an arbitrary point, for the time spent assigning
+ *
+ * @return double	the time
+ */
+static double now(){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * Allocate a workspace aligned to WORKSPACE_ALIGN
+ *
+ * @param bytes	size_t	size of the workspace
+ *
+ * @return void*	the workspace, NULL if the memory is short
+ */
+static void *alignedAlloc(size_t bytes){
+	void *p;
+
+	return posix_memalign(&p, WORKSPACE_ALIGN, bytes) ? NULL : p;
+}
+
+/*
+ * Create a context for k clusters of points of dim dimensions, with the
+ * default options and rules, and the centroids all zero
+ *
+ * @param k			int		number of clusters
+ * @param dim		int		number of dimensions
+ * @param threads	int		threads of the OpenMP build, 0 for the default
+ *
+ * @return KMeans*	the context, to free with freeKMeans, NULL if the memory is short
+ */
+KMeans *createKMeans(int k, int dim, int threads){
+	KMeans *km = (KMeans *) calloc(1, sizeof(KMeans));
+
+	if(km == NULL){
+		return NULL;
+	}
+	km->k = k;
+	km->dim = dim;
+	km->threads = threads;
+	km->kernel = KERNEL_AUTO;
+	initConvergence(&km->stop);
+	km->centroids = km->ownCentroids = (float *) calloc((size_t) k * dim, sizeof(float));
+
+	/* per thread sums, counts and tiles, the first two padded to whole cache lines to avoid false sharing */
+#ifdef _OPENMP
+	km->slabs = threads > 0 ? threads : omp_get_max_threads();
+#else
+	km->slabs = 1;
+#endif
+	km->sumsStride = ((size_t) k * dim * sizeof(float) + WORKSPACE_ALIGN - 1) / WORKSPACE_ALIGN * WORKSPACE_ALIGN / sizeof(float);
+	km->countsStride = ((size_t) k * sizeof(int) + WORKSPACE_ALIGN - 1) / WORKSPACE_ALIGN * WORKSPACE_ALIGN / sizeof(int);
+	km->tileStride = (size_t) dim * TILE_WIDTH;
+	km->sums = (float *) alignedAlloc(km->slabs * km->sumsStride * sizeof(float));
+	km->counts = (int *) alignedAlloc(km->slabs * km->countsStride * sizeof(int));
+	km->tiles = (float *) alignedAlloc(km->slabs * km->tileStride * sizeof(float));
+	km->threadPasses = (ThreadPass *) calloc(km->slabs, sizeof(ThreadPass));
+	km->totals = (float *) calloc((size_t) k * dim, sizeof(float));
+	km->totalCounts = (int *) calloc(k, sizeof(int));
+	if(km->centroids == NULL || km->sums == NULL || km->counts == NULL || km->tiles == NULL
+			|| km->threadPasses == NULL || km->totals == NULL || km->totalCounts == NULL){
+		freeKMeans(km);
+		return NULL;
+	}
+
+	return km;
+}
+
+/*
+ * Free a context and all its workspaces
+ *
+ * @param km	KMeans*	the context
+ *
+ * @return void
+ */
+void freeKMeans(KMeans *km){
+	if(km == NULL){
+		return;
+	}
+	free(km->ownCentroids);
+	free(km->labels);
+	free(km->previous);
+	freeBounds(km->b);
+	free(km->sums);
+	free(km->counts);
+	free(km->totals);
+	free(km->totalCounts);
+	free(km->tiles);
+	free(km->threadPasses);
+	free(km);
+}
+
+/*
+ * Make room for the labels of the points of a call, dropping the other
+ * workspaces sized by the points if they are too small. New labels start
+ * in the first cluster. The kernel of the call is picked as well.
+ *
+ * This function will change the value of km
+ *
+ * @param km	KMeans*	the context
+ * @param size	int		number of points
+ *
+ * @return int	TRUE, or FALSE if the memory is short
+ */
+static int reserve(KMeans *km, int size){
+	km->picked = supportedKernel(km->kernel);
+	if(size > km->capacity){
+		free(km->labels);
+		free(km->previous);
+		freeBounds(km->b);
+		km->previous = NULL;
+		km->b = NULL;
+		km->capacity = 0;
+		if((km->labels = (int *) alignedAlloc(size * sizeof(int))) == NULL){
+			return FALSE;
+		}
+		/* the bounds start from the label of each point, which must be a cluster */
+		memset(km->labels, 0, size * sizeof(int));
+		km->capacity = size;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Make room for the points of the passes to come, and start their bounds
+ * and their labels of the last iteration over. fitKMeans calls it first,
+ * callers driving the passes themselves call it before their first one.
+ *
+ * This function will change the value of km
+ *
+ * @param km	KMeans*	the context, its options set
+ * @param size	int		number of points
+ *
+ * @return int	TRUE, or FALSE if the memory is short
+ */
+int beginKMeans(KMeans *km, int size){
+	if(!reserve(km, size)){
+		return FALSE;
+	}
+	if(km->a){
+		if(km->b == NULL){
+			if((km->b = createBounds(km->capacity, km->dim, km->k)) == NULL){
+				return FALSE;
+			}
+		}else{
+			resetBounds(km->b, size);
+		}
+	}
+	if(tracksChanges(&km->stop) || km->delta > 0){
+		if(km->previous == NULL && (km->previous = (int *) malloc(km->capacity * sizeof(int))) == NULL){
+			return FALSE;
+		}
+		memset(km->previous, 0xff, size * sizeof(int));
+	}
+	km->passes = 0;
+
+	return TRUE;
+}
+
+/*
+ * Start a pass with the current centroids. The bounds follow the moves
+ * of the centroids since the last pass.
+ *
+ * This function will change the value of km
+ *
+ * @param km	KMeans*	the context
+ * @param whole	int		whether the pass sums all the points, otherwise only
+ * 						the moves of the points changing cluster
+ *
+ * @return void
+ */
+void startPass(KMeans *km, int whole){
+	if(km->a){
+		if(km->passes > 0){
+			centroidDrift(km->b, km->centroids, km->k);
+		}
+		centroidSeparation(km->b, km->centroids, km->k);
+		saveCentroids(km->b, km->centroids, km->k);
+	}
+	km->whole = whole;
+	km->moved = km->passes++ > 0;
+	km->carried = FALSE;
+}
+
+/*
+ * Assign the points in [from, to) and add them to the sums of a thread,
+ * or between full sums only move the points changing cluster
+ *
+ * This function will change the value of the labels and bounds of km,
+ * sum, count, tile and stats
+ *
+ * @param km		KMeans*	the context
+ * @param data		float*	the input data, one row of dim values per point
+ * @param from		int		index of the first point
+ * @param to		int		index after the last point
+ * @param sum		float*	the sums of the thread
+ * @param count		int*	the counts of the thread
+ * @param tile		float*	the tile of the thread
+ * @param stats		PassStats*	what to measure besides
+ *
+ * @return long	number of distances computed
+ */
+static long passBlock(KMeans *km, float *data, int from, int to, float *sum, int *count, float *tile, PassStats *stats){
+	long evals = 0;
+	int t;
+
+	if(km->a){
+		for(t = from; t < to; t++){
+			/* move the bounds by the drift of the last update first */
+			if(km->moved){
+				updateBounds(km->b, t, km->labels);
+			}
+			evals += assignHamerly(km->b, data, t, km->centroids, km->k, km->labels);
+		}
+	}else{
+		assignWith(km->picked, km->generic, data, km->dim, from, to, km->centroids, km->k, km->labels, tile);
+		evals += (long) (to - from) * km->k;
+	}
+
+	/* the block is still in cache, add it to the sums of this thread */
+	if(km->whole){
+		stats->inertia = 0;
+		stats->changed = 0;
+		accumulatePoints(data, km->dim, from, to, km->labels, sum, count, stats);
+	}else{
+		stats->changed = movePoints(data, km->dim, from, to, km->labels, km->previous, sum, count);
+		stats->inertia = stats->centroids ? computeInertia(data, km->dim, from, to, km->centroids, km->labels) : 0;
+	}
+
+	return evals;
+}
+
+/*
+ * Assign the points in [from, to) block by block and sum them up, run by
+ * every thread of the team. The sums, counts and measures end up in the
+ * first ones of the context once all threads return.
+ *
+ * This function will change the value of the workspaces of km
+ *
+ * @param km		KMeans*	the context
+ * @param data		float*	the input data, one row of dim values per point
+ * @param from		int		index of the first point
+ * @param to		int		index after the last point
+ *
+ * @return void
+ */
+static void assignPass(KMeans *km, float *data, int from, int to){
+	int i, j, step, id = THREAD_ID, team = TEAM_SIZE;
+	float *sum = km->sums + id * km->sumsStride;
+	int *count = km->counts + id * km->countsStride;
+	float *tile = km->tiles + id * km->tileStride;
+	ThreadPass *pass = km->threadPasses + id;
+	long evals = 0, changed = 0;
+	double inertia = 0;
+	PassStats stats;
+
+	stats.centroids = tracksInertia(&km->stop) ? km->centroids : NULL;
+	stats.previous = km->previous;
+	memset(sum, 0, (size_t) km->k * km->dim * sizeof(float));
+	memset(count, 0, km->k * sizeof(int));
+
+FOR_BLOCKS
+	for(i = from; i < to; i += ASSIGN_BLOCK){
+		j = i + ASSIGN_BLOCK < to ? i + ASSIGN_BLOCK : to;
+		evals += passBlock(km, data, i, j, sum, count, tile, &stats);
+		inertia += stats.inertia;
+		changed += stats.changed;
+	}
+	pass->evals = evals;
+	pass->inertia = inertia;
+	pass->changed = changed;
+
+	/* merge the accumulators pairwise, thread 0 ends up with the totals */
+	for(step = 1; step < team; step *= 2){
+BARRIER
+		if(id % (2 * step) == 0 && id + step < team){
+			for(j = 0; j < km->k * km->dim; j++){
+				sum[j] += sum[step * km->sumsStride + j];
+			}
+			for(j = 0; j < km->k; j++){
+				count[j] += count[step * km->countsStride + j];
+			}
+			pass->evals += pass[step].evals;
+			pass->inertia += pass[step].inertia;
+			pass->changed += pass[step].changed;
+		}
+	}
+BARRIER
+}
+
+/*
+ * Assign the points in [from, to) to the centroids of the pass started
+ * by startPass, and sum them up, or only the moves of those changing
+ * cluster: the sums and counts end up in km->sums and km->counts, the
+ * measures in km->threadPasses[0]. A pass may take several calls over
+ * ranges of the points, each replacing the sums of the one before.
+ *
+ * Inside a parallel region every thread of the team calls it and shares
+ * the work, outside of one it runs a team of its own.
+ *
+ * This function will change the value of the workspaces of km
+ *
+ * @param km		KMeans*	the context
+ * @param data		float*	the input data, one row of dim values per point
+ * @param from		int		index of the first point
+ * @param to		int		index after the last point
+ *
+ * @return long	number of distances computed
+ */
+long passKMeans(KMeans *km, float *data, int from, int to){
+#ifdef _OPENMP
+	if(!omp_in_parallel()){
+PARALLEL_RUN
+		assignPass(km, data, from, to);
+
+		return km->threadPasses[0].evals;
+	}
+#endif
+	assignPass(km, data, from, to);
+
+	return km->threadPasses[0].evals;
+}
+
+/*
+ * Carry the sums and counts of a pass over to km->totals and
+ * km->totalCounts, which a whole pass starts over and a pass of moves
+ * adds to. A pass over several ranges of points, such as the blocks of
+ * a file, carries each range after it is assigned, the first carry of a
+ * whole pass starting over and the others adding to it.
+ *
+ * This function will change the value of km
+ *
+ * @param km	KMeans*	the context, after passKMeans
+ *
+ * @return void
+ */
+void carrySums(KMeans *km){
+	size_t i;
+
+	if(km->whole && !km->carried){
+		memcpy(km->totals, km->sums, (size_t) km->k * km->dim * sizeof(float));
+		memcpy(km->totalCounts, km->counts, km->k * sizeof(int));
+	}else{
+		for(i = 0; i < (size_t) km->k * km->dim; i++){
+			km->totals[i] += km->sums[i];
+		}
+		for(i = 0; i < (size_t) km->k; i++){
+			km->totalCounts[i] += km->counts[i];
+		}
+	}
+	km->carried = TRUE;
+}
+
+/*
+ * Create k centroids from the data
+ *
+ * This function will change the value of c
+ *
+ * @param data	float*	the input data, one row of dim values per point
+ * @param size	int		number of points
+ * @param dim	int		number of dimensions
+ * @param k		int		number of clusters, those past size are left as they are
+ * @param r		int		how to create them, INIT_CHUNKS, INIT_RANDOM or INIT_PLUSPLUS
+ * @param c		float*	the k centroids, one row of dim values each
+ *
+ * @return void
+ */
+void seedCentroids(float *data, int size, int dim, int k, int r, float *c){
+	int i, j;
+
+	if(k > size){
+		k = size;
+	}
+
+	if(r == INIT_RANDOM){
+		randomCentroids(data, size, dim, k, c);
+	}else if(r == INIT_PLUSPLUS){
+		plusPlusCentroids(data, size, dim, k, c);
+	}else{
+		for(i = j = 0; i < k; i++){
+			/*
+			 * pick the first point from k chunks,
+			 * it's not real random, but acceptable
+			 */
+			memcpy(c + (size_t) i * dim, data + (size_t) j * dim, dim * sizeof(float));
+			j += size/k;
+		}
+	}
+}
+
+/*
+ * Move each centroid to the mean of the points of its cluster
+ *
+ * This function will change the value of centroids
+ *
+ * @param sums		float*	the sums of each cluster, one row of dim values each
+ * @param counts	int*	the number of points of each cluster
+ * @param centroids	float*	the k centroids, one row of dim values each
+ * @param k			int		k-means
+ * @param dim		int		number of dimensions
+ *
+ * @return double	how far the centroid moving the most moved, 0 if none moved
+ */
+double updateCentroids(float *sums, int *counts, float *centroids, int k, int dim){
+	int i, t;
+	float temp, *sum, *centroid;
+	double diff, shift, maxShift = 0;
+
+	for(i = 0; i < k; i++){
+		sum = sums + (size_t) i * dim;
+		centroid = centroids + (size_t) i * dim;
+		shift = 0;
+		for(t = 0; t < dim; t++){
+			temp = counts[i] ? sum[t] / counts[i] : 0;
+			diff = (double) temp - centroid[t];
+			shift += diff * diff;
+			centroid[t] = temp;
+		}
+		if(shift > maxShift){
+			maxShift = shift;
+		}
+	}
+
+	return sqrt(maxShift);
+}
+
+/*
+ * Run the k-means iterations from the centroids of the context until
+ * one of its rules stops them, with the options of the context. The
+ * statistics of the run are left in the context.
+ *
+ * This function will change the value of km
+ *
+ * @param km	KMeans*	the context, its centroids set
+ * @param data	float*	the input data, one row of dim values per point
+ * @param size	int		number of points
+ *
+ * @return int*	the label of each point, held by the context until its next call, NULL if the memory is short
+ */
+int *fitKMeans(KMeans *km, float *data, int size){
+	int i, done = FALSE, whole = TRUE;
+	int k = km->k, dim = km->dim;
+	double assignStart = 0, shift, inertia = 0;
+
+	if(!beginKMeans(km, size)){
+		return NULL;
+	}
+
+	km->loops = 0;
+	km->full = 0;
+	km->evals = 0;
+	km->assignTime = 0;
+	startConvergence(&km->stop);
+
+	/* one team runs all the iterations, one of its threads updates the centroids */
+PARALLEL_RUN
+	{
+		do{
+SINGLE
+			{
+				assignStart = now();
+				whole = km->delta <= 0 || km->loops % km->delta == 0;
+				startPass(km, whole);
+			}
+
+			/*
+			 * assign the points and sum them up per thread in a single pass,
+			 * or between full sums only sum up the moves of the points changing cluster
+			 */
+			passKMeans(km, data, 0, size);
+
+SINGLE
+			{
+				km->assignTime += now() - assignStart;
+				km->evals += km->threadPasses[0].evals;
+
+				carrySums(km);
+				shift = updateCentroids(km->totals, km->totalCounts, km->centroids, k, dim);
+
+				km->full += whole;
+				++km->loops;
+				done = converged(&km->stop, km->loops, shift, km->threadPasses[0].inertia, km->threadPasses[0].changed, size);
+				if(km->report != NULL){
+					km->report(&km->stop);
+				}
+			}
+		}while(!done);
+	}
+
+	if(!whole){
+		/* the last centroids are the exact means of their clusters, without drift */
+		memset(km->sums, 0, (size_t) k * dim * sizeof(float));
+		memset(km->counts, 0, k * sizeof(int));
+		accumulatePoints(data, dim, 0, size, km->labels, km->sums, km->counts, NULL);
+		updateCentroids(km->sums, km->counts, km->centroids, k, dim);
+	}
+
+PARALLEL_INERTIA
+	for(i = 0; i < size; i += ASSIGN_BLOCK){
+		inertia += computeInertia(data, dim, i, i + ASSIGN_BLOCK < size ? i + ASSIGN_BLOCK : size, km->centroids, km->labels);
+	}
+	km->inertia = inertia;
+
+	return km->labels;
+}
+
+/*
+ * Assign each point to the closest of the centroids of the context,
+ * which do not move
+ *
+ * This function will change the value of the labels of km
+ *
+ * @param km	KMeans*	the context, its centroids set
+ * @param data	float*	the points, one row of dim values each
+ * @param size	int		number of points
+ *
+ * @return int*	the label of each point, held by the context until its next call, NULL if the memory is short
+ */
+int *predictKMeans(KMeans *km, float *data, int size){
+	int i;
+
+	if(!reserve(km, size)){
+		return NULL;
+	}
+
+PARALLEL_BLOCKS
+	for(i = 0; i < size; i += ASSIGN_BLOCK){
+		assignWith(km->picked, km->generic, data, km->dim, i, i + ASSIGN_BLOCK < size ? i + ASSIGN_BLOCK : size,
+				km->centroids, km->k, km->labels, km->tiles + THREAD_ID * km->tileStride);
+	}
+
+	return km->labels;
+}
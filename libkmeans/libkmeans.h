@@ -0,0 +1,106 @@
+/*
+ * libkmeans.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef LIBKMEANS_H_
+#define LIBKMEANS_H_
+
+#include "common.h"
+#include "convergence.h"
+#include "hamerly.h"
+#include "kernels.h"
+
+/* bytes the workspaces are aligned to, a cache line */
+#define WORKSPACE_ALIGN 64
+
+/*
+ * What a thread measured over its blocks of a pass
+ */
+typedef struct ThreadPass{
+	long evals;		/* number of distances computed */
+	double inertia;	/* sum of the squared distances to the centroids, if tracked */
+	long changed;	/* number of labels changed, if tracked */
+} ThreadPass;
+
+/*
+ * A k-means context: the options, the centroids and the workspaces of the
+ * iterations, kept across calls so fitting or predicting again does not
+ * allocate them anew. The workspaces grow to the most points seen.
+ *
+ * Nothing is printed or written, the statistics of the last fit are left
+ * in the context for the caller, and report, when set, is called after
+ * every iteration with the rules holding its measures. Running short of
+ * memory makes the calls return NULL.
+ *
+ * fitKMeans runs the whole loop. Callers with a loop of their own, such
+ * as one adding up the passes of several processes, call beginKMeans
+ * once, then for every pass startPass, passKMeans over the points and
+ * carrySums, and move the centroids from km->totals and km->totalCounts.
+ * A pass may run passKMeans and carrySums over several blocks of points,
+ * as the streaming front-end does.
+ */
+typedef struct KMeans{
+	int k;			/* number of clusters */
+	int dim;		/* number of dimensions */
+	int threads;	/* threads of the OpenMP build, 0 for the default */
+	int a;			/* whether skip distance computations with bounds */
+	int delta;		/* iterations between full sums of the delta updates, 0 to always sum all */
+	int kernel;		/* the assignment kernel, KERNEL_AUTO for the best the host supports */
+	int generic;	/* whether use the generic assignment kernel for every dimension */
+	Convergence stop;	/* the rules ending the iterations */
+	void (*report)(Convergence *stop);	/* called after every iteration of a fit, NULL for none */
+	float *centroids;	/* the k centroids, one row of dim values each, may point to the caller's own */
+	float *ownCentroids;	/* the centroids allocated with the context */
+
+	/* the workspaces */
+	int picked;		/* the kernel of the last call, the one asked for if the host supports it */
+	int capacity;	/* points the workspaces below hold */
+	int *labels;	/* the label of each point of the last call */
+	int *previous;	/* the labels of the last iteration */
+	Bounds *b;		/* the bounds of the points */
+	int slabs;		/* number of per thread sums below */
+	size_t sumsStride;		/* floats from the sums of a thread to the next */
+	size_t countsStride;	/* ints from the counts of a thread to the next */
+	float *sums;	/* the sums of each thread, the first gets the totals */
+	int *counts;	/* the counts of each thread, the first gets the totals */
+	float *totals;	/* the sums kept across the delta updates */
+	int *totalCounts;
+	size_t tileStride;	/* floats from the tile of a thread to the next */
+	float *tiles;	/* the scratch tile of each thread for the assignment kernels */
+	ThreadPass *threadPasses;	/* the measures of each thread, the first gets the totals */
+	int passes;		/* passes started since beginKMeans */
+	int whole;		/* whether the current pass sums all the points */
+	int moved;		/* whether the centroids moved since the bounds were updated */
+	int carried;	/* whether the current pass carried some sums already */
+
+	/* the statistics of the last fit */
+	int loops;		/* iterations run */
+	int full;		/* iterations summing all the points */
+	long evals;		/* number of distances computed */
+	double assignTime;	/* seconds spent assigning the points */
+	double inertia;	/* sum of the squared distances to the centroids */
+} KMeans;
+
+KMeans *createKMeans(int k, int dim, int threads);
+
+void freeKMeans(KMeans *km);
+
+void seedCentroids(float *data, int size, int dim, int k, int r, float *c);
+
+double updateCentroids(float *sums, int *counts, float *centroids, int k, int dim);
+
+int beginKMeans(KMeans *km, int size);
+
+void startPass(KMeans *km, int whole);
+
+long passKMeans(KMeans *km, float *data, int from, int to);
+
+void carrySums(KMeans *km);
+
+int *fitKMeans(KMeans *km, float *data, int size);
+
+int *predictKMeans(KMeans *km, float *data, int size);
+
+#endif /* LIBKMEANS_H_ */
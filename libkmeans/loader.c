@@ -0,0 +1,909 @@
+/*
+ * loader.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "loader.h"
+#include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+/*
+ * The chunks of the file are parsed by the threads of the OpenMP build,
+ * the other builds parse them one after another
+ */
+#ifdef _OPENMP
+#include <omp.h>
+#define PARALLEL_CHUNKS _Pragma("omp parallel for schedule(dynamic)")
+#else
+#define PARALLEL_CHUNKS
+#endif
+
+/* the file is split in this many chunks per thread, to even out the load */
+#define CHUNKS_PER_THREAD 4
+
+/* no chunk is smaller than this many bytes */
+#define MIN_CHUNK (1 << 20)
+
+/* a part of the file parsed on its own */
+typedef struct{
+	char *start;	/* the first character, at the beginning of a line */
+	char *end;		/* after the last character, at the beginning of a line */
+	size_t offset;	/* index of the first point of the chunk in the data */
+	size_t count;	/* number of points parsed */
+	int complete;	/* whether every line of the chunk held a point */
+} Chunk;
+
+/* the binary file mapped by readData, released by freeData */
+static char *mappedFile = NULL;
+static size_t mappedLength = 0;
+
+/* bytes of a text file read at once when streaming */
+#define STREAM_TEXT (1 << 22)
+
+/* tokens up to this length are copied on the stack for strtof */
+#define TOKEN_LENGTH 64
+
+/* largest mantissa a double holds exactly */
+#define MAX_MANTISSA (1ULL << 53)
+
+/* the message of each LOAD_ error, by its value */
+static const char *loadErrors[] = {
+	"No error", "Fail to open file", "Fail to read file", "Unsupported binary file",
+	"No data in file", "Unable to allocate the points of file", "Fail to write file"
+};
+
+/* powers of ten a double holds exactly */
+static const double powersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * Parse the token at start with strtof, for whatever the fast path
+ * of parseFloat does not handle
+ *
+ * @param start		char*	the first character of the token
+ * @param end		char*	the end of the buffer
+ * @param value		float*	where to store the value
+ *
+ * @return char*	the character after the value, start if there is none
+ */
+static char *slowFloat(char *start, char *end, float *value){
+	char buffer[TOKEN_LENGTH], *token = buffer, *last;
+	size_t length = 0;
+
+	while(start + length < end && !isspace((unsigned char) start[length])){
+		++length;
+	}
+	if(length >= TOKEN_LENGTH){
+		token = (char *) malloc(length + 1);
+	}
+	memcpy(token, start, length);
+	token[length] = '\0';
+
+	*value = strtof(token, &last);
+	start += last - token;
+
+	if(token != buffer){
+		free(token);
+	}
+
+	return start;
+}
+
+/*
+ * Parse the next value of a buffer which is not null terminated
+ *
+ * Plain decimals are parsed with one exact double operation and
+ * rounded to float, which gives the same value as strtof unless the
+ * double lands exactly halfway between two floats. Those, and every
+ * other notation strtof accepts, are handed to strtof.
+ *
+ * This function will change the value of pos and value
+ *
+ * @param pos		char**	the position in the buffer, moved after the value
+ * @param end		char*	the end of the buffer
+ * @param value		float*	where to store the value
+ *
+ * @return int	whether a value was parsed
+ */
+static int parseFloat(char **pos, char *end, float *value){
+	char *p = *pos, *start;
+	unsigned long long mantissa = 0;
+	int exponent = 0, digits = 0, slow = 0, negative = 0, e = 0, eNegative = 0;
+	char *q;
+	union{
+		double d;
+		unsigned long long u;
+	} result;
+
+	while(p < end && isspace((unsigned char) *p)){
+		++p;
+	}
+	start = p;
+
+	if(p < end && (*p == '-' || *p == '+')){
+		negative = *p++ == '-';
+	}
+	for(; p < end && isdigit((unsigned char) *p); p++, digits++){
+		if(mantissa >= MAX_MANTISSA / 10){
+			slow = 1;
+		}else{
+			mantissa = mantissa * 10 + (*p - '0');
+		}
+	}
+	if(p < end && *p == '.'){
+		for(++p; p < end && isdigit((unsigned char) *p); p++, digits++){
+			if(mantissa >= MAX_MANTISSA / 10){
+				slow = 1;
+			}else{
+				mantissa = mantissa * 10 + (*p - '0');
+				--exponent;
+			}
+		}
+	}
+	if(digits > 0 && p < end && (*p == 'e' || *p == 'E')){
+		q = p + 1;
+		if(q < end && (*q == '-' || *q == '+')){
+			eNegative = *q++ == '-';
+		}
+		if(q < end && isdigit((unsigned char) *q)){
+			for(; q < end && isdigit((unsigned char) *q); q++){
+				if(e < 10000){
+					e = e * 10 + (*q - '0');
+				}
+			}
+			exponent += eNegative ? -e : e;
+			p = q;
+		}
+	}
+
+	/* anything else than a plain decimal goes to strtof */
+	if(slow || digits == 0 || (p < end && !isspace((unsigned char) *p))
+			|| exponent < -22 || exponent > 22){
+		p = slowFloat(start, end, value);
+		if(p == start){
+			return FALSE;
+		}
+		*pos = p;
+		return TRUE;
+	}
+
+	result.d = (double) mantissa;
+	result.d = exponent < 0 ? result.d / powersOfTen[-exponent] : result.d * powersOfTen[exponent];
+
+	/* halfway between two floats, rounding again may go the wrong way */
+	if((result.u & 0x1FFFFFFFULL) == 0x10000000ULL){
+		*pos = slowFloat(start, end, value);
+		return TRUE;
+	}
+
+	*value = negative ? -(float) result.d : (float) result.d;
+	*pos = p;
+
+	return TRUE;
+}
+
+/*
+ * Describe what went wrong with a data file
+ *
+ * @param error	int		LOAD_OK or one of the LOAD_ errors
+ *
+ * @return const char*	the message, to be followed by the file name
+ */
+const char *loadError(int error){
+	if(error < LOAD_OK || error > LOAD_WRITE){
+		return "Unknown error with file";
+	}
+
+	return loadErrors[error];
+}
+
+/*
+ * Count the values on a line of the input file
+ *
+ * @param line	char*	the line to be parsed
+ * @param end	char*	the end of the line
+ *
+ * @return int	number of values, i.e. the dimension of the points
+ */
+int countDimensions(char *line, char *end){
+	int dim = 0;
+	float value;
+
+	while(parseFloat(&line, end, &value)){
+		++dim;
+	}
+
+	return dim;
+}
+
+/*
+ * Find the first line holding something other than white space
+ *
+ * @param start	char*	the beginning of the text
+ * @param end	char*	the end of the text
+ *
+ * @return char*	the beginning of that line, end when there is none
+ */
+char *skipBlankLines(char *start, char *end){
+	char *p = start;
+
+	while(p < end){
+		if(*p == '\n'){
+			start = ++p;
+		}else if(isspace((unsigned char) *p)){
+			++p;
+		}else{
+			return start;
+		}
+	}
+
+	return end;
+}
+
+/*
+ * Count the lines of a chunk, i.e. the most points it may hold
+ *
+ * @param c		Chunk*	the chunk
+ *
+ * @return size_t	number of lines
+ */
+static size_t countLines(Chunk *c){
+	size_t lines = 0;
+	char *p = c->start;
+
+	while(p < c->end && (p = (char *) memchr(p, '\n', c->end - p)) != NULL){
+		++lines;
+		++p;
+	}
+	/* the last line of the file may miss its newline */
+	if(c->end > c->start && c->end[-1] != '\n'){
+		++lines;
+	}
+
+	return lines;
+}
+
+/*
+ * Parse the points of a chunk, one per line, into data from the offset
+ * of the chunk on. Blank lines are skipped, the chunk stops at the first
+ * line which does not hold a point.
+ *
+ * This function will change the value of c and data
+ *
+ * @param c		Chunk*	the chunk
+ * @param dim	int		number of dimensions
+ * @param data	float*	the points of the whole file
+ *
+ * @return void
+ */
+static void parseChunk(Chunk *c, int dim, float *data){
+	char *pos = c->start, *eol;
+	float *point = data + c->offset * dim;
+	int t;
+
+	c->count = 0;
+	c->complete = TRUE;
+	while(pos < c->end){
+		if((eol = (char *) memchr(pos, '\n', c->end - pos)) == NULL){
+			eol = c->end;
+		}
+
+		for(t = 0; t < dim && parseFloat(&pos, eol, &point[t]); t++);
+		if(t < dim){
+			while(pos < eol && isspace((unsigned char) *pos)){
+				++pos;
+			}
+			if(t > 0 || pos < eol){
+				c->complete = FALSE;
+				return;
+			}
+		}else{
+			point += dim;
+			++c->count;
+		}
+
+		pos = eol + 1;
+	}
+}
+
+/*
+ * Take the points from a mapped binary file, rows are used in place
+ * and columns are transposed into a new buffer
+ *
+ * This function will change the value of count, dim and error
+ *
+ * @param map		char*	the mapped file
+ * @param length	size_t	the length of the file
+ * @param count		int*	number of points
+ * @param dim		int*	number of dimensions
+ * @param error		int*	why the points could not be taken
+ *
+ * @return data		float*	the points, one row of dim values per point, NULL on failure
+ */
+static float *readBinary(char *map, size_t length, int *count, int *dim, int *error){
+	BinaryHeader *h = (BinaryHeader *) map;
+	float *columns = (float *) (map + BINARY_HEADER), *data;
+	size_t i;
+	int t;
+
+	if(h->dtype != BINARY_FLOAT32 || (h->layout != LAYOUT_ROWS && h->layout != LAYOUT_COLUMNS)){
+		*error = LOAD_FORMAT;
+		return NULL;
+	}
+	if(h->count == 0 || h->dim == 0 || h->count > INT_MAX || h->dim > INT_MAX
+			|| (length - BINARY_HEADER) / sizeof(float) / h->dim < h->count){
+		*error = LOAD_EMPTY;
+		return NULL;
+	}
+	*count = h->count;
+	*dim = h->dim;
+
+	if(h->layout == LAYOUT_ROWS){
+		mappedFile = map;
+		mappedLength = length;
+		return columns;
+	}
+
+	if((data = (float *) malloc((size_t) *count * *dim * sizeof(float))) == NULL){
+		*error = LOAD_MEMORY;
+		return NULL;
+	}
+	for(t = 0; t < *dim; t++){
+		for(i = 0; i < (size_t) *count; i++){
+			data[i * *dim + t] = columns[t * (size_t) *count + i];
+		}
+	}
+	munmap(map, length);
+
+	return data;
+}
+
+/*
+ * Parse the points of some text, one per line, the values separated by
+ * white space. The text is split in chunks at line breaks. The lines of
+ * every chunk are counted first, which places each chunk in the data,
+ * then the chunks are parsed concurrently in place, so the points keep
+ * the order of the lines.
+ *
+ * This function will change the value of count
+ *
+ * @param start	char*	the first byte of the text
+ * @param end	char*	after the last byte of the text
+ * @param dim	int		number of dimensions
+ * @param count	int*	number of points, -1 when they do not fit in memory or in an int
+ *
+ * @return data		float*	the points, one row of dim values per point, NULL when there are none
+ */
+float *parseText(char *start, char *end, int dim, int *count){
+	int threads = 1;
+	size_t i, chunks, length = (size_t) (end - start), chunkLength, lines;
+	Chunk *c;
+	float *data;
+
+	/* split the text in chunks starting at the beginning of a line */
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	chunks = (size_t) threads * CHUNKS_PER_THREAD;
+	if(length / chunks < MIN_CHUNK){
+		chunks = length / MIN_CHUNK + 1;
+	}
+	chunkLength = length / chunks;
+	if((c = (Chunk *) malloc(chunks * sizeof(Chunk))) == NULL){
+		*count = -1;
+		return NULL;
+	}
+	c[0].start = start;
+	for(i = 1; i < chunks; i++){
+		c[i].start = c[i - 1].start + chunkLength;
+		if(c[i].start <= c[i - 1].start || c[i].start >= end
+				|| (c[i].start = (char *) memchr(c[i].start - 1, '\n', end - c[i].start + 1)) == NULL){
+			c[i].start = end;
+		}else{
+			++c[i].start;
+		}
+		c[i - 1].end = c[i].start;
+	}
+	c[chunks - 1].end = end;
+
+	/* place the chunks by their number of lines */
+PARALLEL_CHUNKS
+	for(i = 0; i < chunks; i++){
+		c[i].offset = countLines(&c[i]);
+	}
+	for(i = 0, lines = 0; i < chunks; i++){
+		c[i].count = c[i].offset;
+		c[i].offset = lines;
+		lines += c[i].count;
+	}
+
+	if((data = (float *) malloc(lines * dim * sizeof(float))) == NULL && lines > 0){
+		free(c);
+		*count = -1;
+		return NULL;
+	}
+
+PARALLEL_CHUNKS
+	for(i = 0; i < chunks; i++){
+		parseChunk(&c[i], dim, data);
+	}
+
+	/* close the gaps left by blank lines, and drop everything after a bad one */
+	for(i = 0, lines = 0; i < chunks; i++){
+		if(c[i].offset != lines){
+			memmove(data + lines * dim, data + c[i].offset * dim, c[i].count * dim * sizeof(float));
+		}
+		lines += c[i].count;
+		if(!c[i].complete){
+			break;
+		}
+	}
+	free(c);
+	if(lines > INT_MAX){
+		free(data);
+		*count = -1;
+		return NULL;
+	}
+	*count = (int) lines;
+	data = (float *) realloc(data, lines * dim * sizeof(float));
+
+	return data;
+}
+
+/*
+ * Reads the data points from input file
+ *
+ * Binary files, see BinaryHeader, are used as they are mapped. Text
+ * files are mapped into memory and parsed by parseText.
+ * The dimension of the points is the number of values on the first line
+ * which is not blank.
+ * This function will change the value of count, dim and error
+ *
+ * @param fileName	char*	the file path and name to be read
+ * @param count		int*	number of file lines
+ * @param dim		int*	number of dimensions
+ * @param error		int*	why the file could not be read, see loadError
+ *
+ * @return data		float*	the points, one row of dim values per point, NULL on failure
+ *
+ */
+float *readData(char *fileName, int *count, int *dim, int *error){
+	int fd;
+	struct stat st;
+	char *map, *end, *first, *eol;
+	size_t length;
+	float *data;
+
+	*error = LOAD_OK;
+	if((fd = open(fileName, O_RDONLY)) == -1){
+		*error = LOAD_OPEN;
+		return NULL;
+	}
+	if(fstat(fd, &st) == -1){
+		close(fd);
+		*error = LOAD_OPEN;
+		return NULL;
+	}
+	if((length = (size_t) st.st_size) == 0){
+		close(fd);
+		*error = LOAD_EMPTY;
+		return NULL;
+	}
+	map = (char *) mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		*error = LOAD_OPEN;
+		return NULL;
+	}
+	madvise(map, length, MADV_SEQUENTIAL);
+	end = map + length;
+
+	if(length >= BINARY_HEADER && memcmp(map, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0){
+		if((data = readBinary(map, length, count, dim, error)) == NULL){
+			munmap(map, length);
+		}
+		return data;
+	}
+
+	first = skipBlankLines(map, end);
+	if((eol = (char *) memchr(first, '\n', end - first)) == NULL){
+		eol = end;
+	}
+	if((*dim = countDimensions(first, eol)) == 0){
+		munmap(map, length);
+		*error = LOAD_EMPTY;
+		return NULL;
+	}
+
+	data = parseText(map, end, *dim, count);
+	munmap(map, length);
+	if(*count <= 0){
+		free(data);
+		*error = *count < 0 ? LOAD_MEMORY : LOAD_EMPTY;
+		return NULL;
+	}
+
+	return data;
+}
+
+/*
+ * Whether the points returned by readData are a binary file used as
+ * it is mapped, rather than parsed or transposed into memory
+ *
+ * @param data	float*	the points
+ *
+ * @return int	TRUE if the points are mapped
+ */
+int mappedData(float *data){
+	return data != NULL && mappedFile != NULL && (char *) data == mappedFile + BINARY_HEADER;
+}
+
+/*
+ * Release the points returned by readData
+ *
+ * @param data	float*	the points
+ *
+ * @return void
+ */
+void freeData(float *data){
+	if(mappedData(data)){
+		munmap(mappedFile, mappedLength);
+		mappedFile = NULL;
+	}else{
+		free(data);
+	}
+}
+
+/*
+ * Write the points to a binary file, row by row, see BinaryHeader
+ *
+ * @param fileName	char*	the file path and name to be written
+ * @param data		float*	the points, one row of dim values per point
+ * @param count		int		number of points
+ * @param dim		int		number of dimensions
+ *
+ * @return int	LOAD_OK, or why the file could not be written
+ */
+int writeBinary(char *fileName, float *data, int count, int dim){
+	FILE *pWrite;
+	BinaryHeader h;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+	h.count = count;
+	h.dim = dim;
+	h.dtype = BINARY_FLOAT32;
+	h.layout = LAYOUT_ROWS;
+
+	if((pWrite = fopen(fileName, "wb")) == NULL){
+		return LOAD_OPEN;
+	}
+	if(fwrite(&h, sizeof(h), 1, pWrite) != 1
+			|| fwrite(data, sizeof(float) * dim, count, pWrite) != (size_t) count){
+		fclose(pWrite);
+		return LOAD_WRITE;
+	}
+
+	return fclose(pWrite) == 0 ? LOAD_OK : LOAD_WRITE;
+}
+
+/*
+ * Read more of a text file behind the bytes not parsed yet, the buffer
+ * grows when a single line does not fit, a read interrupted by a signal
+ * is retried
+ *
+ * This function will change the value of s
+ *
+ * @param s		Stream*	the stream
+ *
+ * @return int	whether the file could be read, s->error telling why not
+ */
+static int fillText(Stream *s){
+	ssize_t n;
+	char *text;
+
+	memmove(s->text, s->text + s->textPos, s->textEnd - s->textPos);
+	s->textEnd -= s->textPos;
+	s->textPos = 0;
+	if(s->textEnd == s->textSize){
+		if((text = (char *) realloc(s->text, s->textSize * 2)) == NULL){
+			s->error = LOAD_MEMORY;
+			return FALSE;
+		}
+		s->text = text;
+		s->textSize *= 2;
+	}
+
+	while((n = read(s->fd, s->text + s->textEnd, s->textSize - s->textEnd)) == -1){
+		if(errno != EINTR){
+			s->error = LOAD_READ;
+			return FALSE;
+		}
+	}
+	if(n == 0){
+		s->eof = TRUE;
+	}
+	s->textEnd += (size_t) n;
+
+	return TRUE;
+}
+
+/*
+ * Read exactly length bytes at offset
+ *
+ * @param s			Stream*	the stream
+ * @param buffer	void*	where to read to
+ * @param length	size_t	number of bytes
+ * @param offset	off_t	position in the file
+ *
+ * @return int	whether all the bytes were read
+ */
+static int readFully(Stream *s, void *buffer, size_t length, off_t offset){
+	ssize_t n;
+
+	while(length > 0){
+		if((n = pread(s->fd, buffer, length, offset)) <= 0){
+			if(n == -1 && errno == EINTR){
+				continue;
+			}
+			return FALSE;
+		}
+		buffer = (char *) buffer + n;
+		length -= (size_t) n;
+		offset += n;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Read the next block of points, one per line of a text file or the
+ * next rows of a binary one
+ *
+ * This function will change the value of s and block
+ *
+ * @param s			Stream*	the stream
+ * @param block		float*	where to store the points
+ *
+ * @return int	number of points read, 0 at the end of the file, -1 when the file
+ * 				could not be read, s->error telling why
+ */
+static int readBlock(Stream *s, float *block){
+	int count = 0, t;
+	size_t i, left;
+	char *pos, *eol;
+
+	if(s->binary){
+		left = s->count - s->next;
+		count = left < (size_t) s->blockSize ? (int) left : s->blockSize;
+		if(s->layout == LAYOUT_ROWS){
+			if(!readFully(s, block, (size_t) count * s->dim * sizeof(float),
+					BINARY_HEADER + (off_t) s->next * s->dim * sizeof(float))){
+				s->error = LOAD_READ;
+				return -1;
+			}
+		}else{
+			for(t = 0; t < s->dim; t++){
+				if(!readFully(s, s->column, (size_t) count * sizeof(float),
+						BINARY_HEADER + ((off_t) t * s->count + s->next) * sizeof(float))){
+					s->error = LOAD_READ;
+					return -1;
+				}
+				for(i = 0; i < (size_t) count; i++){
+					block[i * s->dim + t] = s->column[i];
+				}
+			}
+		}
+		s->next += count;
+		return count;
+	}
+
+	while(count < s->blockSize && !s->stopped){
+		pos = s->text + s->textPos;
+		if((eol = (char *) memchr(pos, '\n', s->textEnd - s->textPos)) == NULL){
+			if(!s->eof){
+				if(!fillText(s)){
+					return -1;
+				}
+				continue;
+			}
+			if(s->textPos == s->textEnd){
+				break;
+			}
+			/* the last line of the file may miss its newline */
+			eol = s->text + s->textEnd;
+		}
+
+		for(t = 0; t < s->dim && parseFloat(&pos, eol, &block[(size_t) count * s->dim + t]); t++);
+		if(t == s->dim){
+			++count;
+		}else{
+			while(pos < eol && isspace((unsigned char) *pos)){
+				++pos;
+			}
+			if(t > 0 || pos < eol){
+				s->stopped = TRUE;
+			}
+		}
+
+		s->textPos = eol < s->text + s->textEnd ? (size_t) (eol - s->text) + 1 : s->textEnd;
+	}
+	s->next += count;
+
+	return count;
+}
+
+/*
+ * Body of the thread reading the block ahead
+ *
+ * @param arg	void*	the stream
+ *
+ * @return void*	nothing
+ */
+static void *readAhead(void *arg){
+	Stream *s = (Stream *) arg;
+
+	s->filled[s->ahead] = readBlock(s, s->blocks[s->ahead]);
+
+	return NULL;
+}
+
+/*
+ * Open a text or binary file to be read block by block, only two
+ * blocks of points are held in memory at a time
+ *
+ * This function will change the value of error
+ *
+ * @param fileName	char*	the file path and name to be read
+ * @param blockSize	int		most points of a block
+ * @param error		int*	why the file could not be opened, see loadError
+ *
+ * @return Stream*	the stream, positioned at the first point, NULL on failure
+ */
+Stream *openStream(char *fileName, int blockSize, int *error){
+	Stream *s = (Stream *) calloc(1, sizeof(Stream));
+	BinaryHeader h;
+	char *first, *eol;
+
+	*error = LOAD_OK;
+	if(s == NULL){
+		*error = LOAD_MEMORY;
+		return NULL;
+	}
+	if((s->fd = open(fileName, O_RDONLY)) == -1){
+		free(s);
+		*error = LOAD_OPEN;
+		return NULL;
+	}
+	s->blockSize = blockSize;
+
+	if(read(s->fd, &h, sizeof(h)) == sizeof(h) && memcmp(h.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0){
+		if(h.dtype != BINARY_FLOAT32 || (h.layout != LAYOUT_ROWS && h.layout != LAYOUT_COLUMNS)){
+			closeStream(s);
+			*error = LOAD_FORMAT;
+			return NULL;
+		}
+		s->binary = TRUE;
+		s->layout = h.layout;
+		s->count = h.count;
+		s->dim = h.dim;
+		if(s->layout == LAYOUT_COLUMNS && (s->column = (float *) malloc((size_t) blockSize * sizeof(float))) == NULL){
+			closeStream(s);
+			*error = LOAD_MEMORY;
+			return NULL;
+		}
+	}else{
+		s->textSize = STREAM_TEXT;
+		if((s->text = (char *) malloc(s->textSize)) == NULL){
+			closeStream(s);
+			*error = LOAD_MEMORY;
+			return NULL;
+		}
+		rewindStream(s);
+		first = skipBlankLines(s->text, s->text + s->textEnd);
+		while((eol = (char *) memchr(first, '\n', s->text + s->textEnd - first)) == NULL && !s->eof){
+			if(!fillText(s)){
+				*error = s->error;
+				closeStream(s);
+				return NULL;
+			}
+			first = skipBlankLines(s->text, s->text + s->textEnd);
+		}
+		s->dim = countDimensions(first, eol != NULL ? eol : s->text + s->textEnd);
+	}
+	if(s->dim <= 0){
+		closeStream(s);
+		*error = LOAD_EMPTY;
+		return NULL;
+	}
+
+	s->blocks[0] = (float *) malloc((size_t) blockSize * s->dim * sizeof(float));
+	s->blocks[1] = (float *) malloc((size_t) blockSize * s->dim * sizeof(float));
+	if(s->blocks[0] == NULL || s->blocks[1] == NULL){
+		closeStream(s);
+		*error = LOAD_MEMORY;
+		return NULL;
+	}
+	rewindStream(s);
+
+	return s;
+}
+
+/*
+ * Get the next block of points and start reading the one after it
+ *
+ * The block stays valid until the next call.
+ * This function will change the value of s and block
+ *
+ * @param s			Stream*	the stream
+ * @param block		float**	where to store the block
+ *
+ * @return int	number of points in the block, 0 at the end of the file, -1 when the
+ * 				file could not be read, s->error telling why
+ */
+int nextBlock(Stream *s, float **block){
+	int count;
+
+	if(s->pending){
+		pthread_join(s->reader, NULL);
+		s->pending = FALSE;
+	}else{
+		s->filled[s->ahead] = readBlock(s, s->blocks[s->ahead]);
+	}
+	*block = s->blocks[s->ahead];
+	count = s->filled[s->ahead];
+
+	s->ahead ^= 1;
+	if(count > 0){
+		s->pending = pthread_create(&s->reader, NULL, readAhead, s) == 0;
+	}
+
+	return count;
+}
+
+/*
+ * Go back to the first point of the stream
+ *
+ * @param s		Stream*	the stream
+ *
+ * @return void
+ */
+void rewindStream(Stream *s){
+	if(s->pending){
+		pthread_join(s->reader, NULL);
+		s->pending = FALSE;
+	}
+	s->next = 0;
+	s->error = LOAD_OK;
+
+	if(!s->binary){
+		lseek(s->fd, 0, SEEK_SET);
+		s->textPos = s->textEnd = 0;
+		s->eof = FALSE;
+		s->stopped = FALSE;
+	}
+}
+
+/*
+ * Close the stream and release its blocks
+ *
+ * @param s		Stream*	the stream
+ *
+ * @return void
+ */
+void closeStream(Stream *s){
+	rewindStream(s);
+	close(s->fd);
+	free(s->blocks[0]);
+	free(s->blocks[1]);
+	free(s->column);
+	free(s->text);
+	free(s);
+}
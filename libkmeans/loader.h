@@ -0,0 +1,96 @@
+/*
+ * loader.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef LOADER_H_
+#define LOADER_H_
+
+#include "common.h"
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * Binary data file: a header followed by the values as raw floats in the
+ * byte order of the machine, either row by row (the layout the kernels
+ * use, mapped without a copy) or column by column (transposed on load)
+ */
+#define BINARY_MAGIC "KMEANSB"
+#define BINARY_FLOAT32 0
+#define LAYOUT_ROWS 0
+#define LAYOUT_COLUMNS 1
+
+/* size of the header, the values start aligned for the widest vector loads */
+#define BINARY_HEADER 64
+
+/* what went wrong with a data file, see loadError */
+#define LOAD_OK 0
+#define LOAD_OPEN 1		/* the file can not be opened or mapped */
+#define LOAD_READ 2		/* reading the file failed */
+#define LOAD_FORMAT 3	/* a binary file of an unsupported type or layout */
+#define LOAD_EMPTY 4	/* no point in the file */
+#define LOAD_MEMORY 5	/* the points do not fit in memory */
+#define LOAD_WRITE 6	/* writing the file failed */
+
+typedef struct{
+	char magic[8];		/* BINARY_MAGIC, null terminated */
+	uint64_t count;		/* number of points */
+	uint32_t dim;		/* number of dimensions */
+	uint32_t dtype;		/* type of the values, BINARY_FLOAT32 */
+	uint32_t layout;	/* LAYOUT_ROWS or LAYOUT_COLUMNS */
+	char padding[BINARY_HEADER - 28];
+} BinaryHeader;
+
+/*
+ * A file read block by block, the next block is read in the background
+ * while the current one is processed, see nextBlock
+ */
+typedef struct Stream{
+	int fd;				/* the open file */
+	int dim;			/* number of dimensions */
+	int blockSize;		/* most points of a block */
+	int binary;			/* whether the file is binary */
+	int layout;			/* layout of a binary file */
+	size_t count;		/* number of points of a binary file */
+	size_t next;		/* index of the next point to be read */
+	float *blocks[2];	/* the current block and the one read ahead */
+	int filled[2];		/* number of points in each block */
+	int ahead;			/* the block read ahead */
+	int pending;		/* whether the block ahead is still being read */
+	pthread_t reader;	/* the thread reading the block ahead */
+	float *column;		/* a block of one column of a binary file */
+	char *text;			/* bytes of a text file not parsed yet */
+	size_t textSize;	/* capacity of text */
+	size_t textPos;		/* the first byte not parsed */
+	size_t textEnd;		/* after the last byte read */
+	int eof;			/* whether the whole text file has been read */
+	int stopped;		/* whether a line without a point was found */
+	int error;			/* LOAD_OK, or why the last block could not be read */
+} Stream;
+
+const char *loadError(int error);
+
+int countDimensions(char *line, char *end);
+
+char *skipBlankLines(char *start, char *end);
+
+float *parseText(char *start, char *end, int dim, int *count);
+
+float *readData(char *fileName, int *count, int *dim, int *error);
+
+int mappedData(float *data);
+
+void freeData(float *data);
+
+int writeBinary(char *fileName, float *data, int count, int dim);
+
+Stream *openStream(char *fileName, int blockSize, int *error);
+
+int nextBlock(Stream *s, float **block);
+
+void rewindStream(Stream *s);
+
+void closeStream(Stream *s);
+
+#endif /* LOADER_H_ */
@@ -0,0 +1,93 @@
+/*
+ * minibatch.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "minibatch.h"
+#include "libkmeans.h"
+#include "seeding.h"
+
+/*
+ * Seconds since an arbitrary point, for the time budget
+ *
+ * @return double	the time
+ */
+static double now(){
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/*
+ * Mini-batch k-means: every iteration assigns a batch of random points
+ * and moves each centroid towards the points assigned to it, at a rate
+ * of one over the number of points it has been assigned so far. The
+ * iterations stop after the given number of batches, or once the time
+ * budget is spent, and the context assigns every point at the end.
+ * The batches run are left in km->loops, the time of the final
+ * assignment in km->assignTime and its inertia in km->inertia.
+ *
+ * This function will change the value of the centroids, labels and statistics of km
+ *
+ * @param km		KMeans*	the context, its centroids set
+ * @param data		float*	the input data, one row of dim values per point
+ * @param size		int		number of points
+ * @param batch		int		number of points per batch
+ * @param batches	int		most batches to run
+ * @param seconds	double	time budget of the batches, 0 for none
+ *
+ * @return int*	the label of each point, held by km, NULL when out of memory
+ */
+int *miniBatchKMeans(KMeans *km, float *data, int size, int batch, int batches, double seconds){
+	int k = km->k, dim = km->dim;
+	float *centroids = km->centroids;
+	int *labels = NULL;
+	int *batchLabels = (int *) calloc(batch, sizeof(int));
+	float *batchData = (float *) malloc((size_t) batch * dim * sizeof(float));
+	float *tile = createTile(dim);
+	long *seen = (long *) calloc(k, sizeof(long));	/* points assigned to each centroid so far */
+	int kernel = supportedKernel(km->kernel);
+	int ready = batchLabels != NULL && batchData != NULL && tile != NULL && seen != NULL;
+	int j, t, loops;
+	double start = now(), assignStart;
+	float rate, *point, *centroid;
+
+	for(loops = 0; ready && loops < batches && (seconds <= 0 || now() - start < seconds); loops++){
+		/* draw the batch */
+		for(j = 0; j < batch; j++){
+			memcpy(batchData + (size_t) j * dim, data + (size_t) randomPoint(size) * dim, dim * sizeof(float));
+		}
+
+		/* assign it to the centroids as they were before the batch */
+		assignWith(kernel, km->generic, batchData, dim, 0, batch, centroids, k, batchLabels, tile);
+
+		/* move each centroid towards its points */
+		for(j = 0; j < batch; j++){
+			point = batchData + (size_t) j * dim;
+			centroid = centroids + (size_t) batchLabels[j] * dim;
+			rate = 1.0f / ++seen[batchLabels[j]];
+			for(t = 0; t < dim; t++){
+				centroid[t] += rate * (point[t] - centroid[t]);
+			}
+		}
+	}
+	km->loops = loops;
+
+	/* assign every point to the final centroids */
+	assignStart = now();
+	if(ready && (labels = predictKMeans(km, data, size)) != NULL){
+		km->assignTime = now() - assignStart;
+		km->inertia = computeInertia(data, dim, 0, size, centroids, labels);
+	}
+
+	/*  Clean up */
+	free(batchLabels);
+	free(batchData);
+	free(tile);
+	free(seen);
+
+	return labels;
+}
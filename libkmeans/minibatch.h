@@ -0,0 +1,19 @@
+/*
+ * minibatch.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef MINIBATCH_H_
+#define MINIBATCH_H_
+
+#include "common.h"
+
+/* batches run by default when no time budget ends them first */
+#define DEFAULT_BATCHES 100
+
+struct KMeans;	/* see libkmeans.h */
+
+int *miniBatchKMeans(struct KMeans *km, float *data, int size, int batch, int batches, double seconds);
+
+#endif /* MINIBATCH_H_ */
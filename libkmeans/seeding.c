@@ -0,0 +1,280 @@
+/*
+ * seeding.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "seeding.h"
+#include "kernels.h"
+
+/*
+ * The weights of the blocks are updated by the threads of the OpenMP
+ * build, the other builds update them one after another
+ */
+#ifdef _OPENMP
+#define PARALLEL_BLOCKS _Pragma("omp parallel for schedule(static)")
+#else
+#define PARALLEL_BLOCKS
+#endif
+
+/*
+ * A random point index, rand() alone may not cover every point
+ *
+ * @param size	int		number of points
+ *
+ * @return int	the index
+ */
+int randomPoint(int size){
+	return (int) ((((unsigned long long) rand() << 31) ^ (unsigned long long) rand()) % size);
+}
+
+/*
+ * A random number in [0, 1) with the full precision of a double
+ *
+ * @return double	the number
+ */
+double randomUnit(){
+	unsigned long long bits = ((unsigned long long) rand() << 31) ^ (unsigned long long) rand();
+
+	return (bits & ((1ULL << 53) - 1)) / (double) (1ULL << 53);
+}
+
+/*
+ * Create the centroids with random coordinates within the range of the
+ * data in each dimension
+ *
+ * This function will change the value of c
+ *
+ * @param data	float*	the input data, one row of dim values per point
+ * @param size	int		number of points
+ * @param dim	int		number of dimensions
+ * @param k		int		number of clusters
+ * @param c		float*	the k centroids, one row of dim values each
+ *
+ * @return void
+ */
+void randomCentroids(float *data, int size, int dim, int k, float *c){
+	float *low = (float *) malloc(dim * sizeof(float));
+	float *high = (float *) malloc(dim * sizeof(float));
+	float *point;
+	int i, t;
+
+	memcpy(low, data, dim * sizeof(float));
+	memcpy(high, data, dim * sizeof(float));
+	for(i = 1; i < size; i++){
+		point = data + (size_t) i * dim;
+		for(t = 0; t < dim; t++){
+			if(point[t] < low[t]){
+				low[t] = point[t];
+			}else if(point[t] > high[t]){
+				high[t] = point[t];
+			}
+		}
+	}
+
+	for(i = 0; i < k; i++){
+		for(t = 0; t < dim; t++){
+			c[(size_t) i * dim + t] = low[t] + (float) randomUnit() * (high[t] - low[t]);
+		}
+	}
+
+	free(low);
+	free(high);
+}
+
+/*
+ * Squared distance between two points, summed up in double
+ *
+ * @param a		float*	a point
+ * @param b		float*	another point
+ * @param dim	int		number of dimensions
+ *
+ * @return double	the squared distance
+ */
+double squareDistance(float *a, float *b, int dim){
+	double diff, sum = 0;
+	int t;
+
+	for(t = 0; t < dim; t++){
+		diff = (double) a[t] - b[t];
+		sum += diff * diff;
+	}
+
+	return sum;
+}
+
+/*
+ * k-means++ seeding: the first centroid is a random point, every next
+ * one a point drawn with a probability proportional to its squared
+ * distance to the closest centroid so far.
+ *
+ * The distances are kept per point and summed up per block of points,
+ * both updated in parallel after each new centroid. A draw walks the
+ * running sum of the blocks to find its block, then the running sum of
+ * the points in that block, so it costs size / ASSIGN_BLOCK plus
+ * ASSIGN_BLOCK steps. The blocks do not depend on the number of
+ * threads, a seed gives the same centroids with any of them.
+ *
+ * This function will change the value of c
+ *
+ * @param data	float*	the input data, one row of dim values per point
+ * @param size	int		number of points
+ * @param dim	int		number of dimensions
+ * @param k		int		number of clusters, at most size
+ * @param c		float*	the k centroids, one row of dim values each
+ *
+ * @return void
+ */
+void plusPlusCentroids(float *data, int size, int dim, int k, float *c){
+	int blocks = (size + ASSIGN_BLOCK - 1) / ASSIGN_BLOCK;
+	double *weights = (double *) malloc((size_t) size * sizeof(double));	/* squared distance to the closest centroid */
+	double *blockWeights = (double *) malloc(blocks * sizeof(double));	/* sum of the weights of each block */
+	double target, total;
+	int i, j, b, end;
+
+	for(j = 0; j < k; j++){
+		if(j == 0){
+			i = randomPoint(size);
+		}else{
+			for(b = 0, total = 0; b < blocks; b++){
+				total += blockWeights[b];
+			}
+			if(total > 0){
+				/* walk to the block, then to the point the draw falls on */
+				target = randomUnit() * total;
+				for(b = 0; b < blocks - 1 && target >= blockWeights[b]; b++){
+					target -= blockWeights[b];
+				}
+				end = (b + 1) * ASSIGN_BLOCK < size ? (b + 1) * ASSIGN_BLOCK : size;
+				for(i = b * ASSIGN_BLOCK; i < end - 1 && target >= weights[i]; i++){
+					target -= weights[i];
+				}
+			}else{
+				/* every point is a centroid already */
+				i = randomPoint(size);
+			}
+		}
+		memcpy(c + (size_t) j * dim, data + (size_t) i * dim, dim * sizeof(float));
+
+		/* the new centroid may be the closest one now */
+PARALLEL_BLOCKS
+		for(b = 0; b < blocks; b++){
+			int p, last = (b + 1) * ASSIGN_BLOCK < size ? (b + 1) * ASSIGN_BLOCK : size;
+			double d, sum = 0;
+
+			for(p = b * ASSIGN_BLOCK; p < last; p++){
+				d = squareDistance(data + (size_t) p * dim, c + (size_t) j * dim, dim);
+				if(j == 0 || d < weights[p]){
+					weights[p] = d;
+				}
+				sum += weights[p];
+			}
+			blockWeights[b] = sum;
+		}
+	}
+
+	free(weights);
+	free(blockWeights);
+}
+
+/*
+ * Cluster weighted candidates into k centroids, as the last step of
+ * k-means||: k-means++ seeding with each candidate drawn in proportion
+ * to its weight times its squared distance, then weighted Lloyd
+ * iterations until the assignment settles
+ *
+ * This function will change the value of c
+ *
+ * @param candidates	float*	the candidates, one row of dim values each
+ * @param weights		long*	the number of points closest to each candidate
+ * @param count			int		number of candidates
+ * @param dim			int		number of dimensions
+ * @param k				int		number of clusters
+ * @param kernel		int		the assignment kernel, one the host supports
+ * @param generic		int		whether use the generic assignment kernel for every dimension
+ * @param c				float*	the k centroids, one row of dim values each
+ *
+ * @return int	FALSE when there are no candidates or the memory runs out, c is left as it is
+ */
+int reclusterCandidates(float *candidates, long *weights, int count, int dim, int k, int kernel, int generic, float *c){
+	double *d2, *sums, *totals;	/* d2 is the weighted squared distance to the closest centroid */
+	int *labels, *old;
+	float *tile;
+	double target, total, d;
+	int i, j, t, loops, changed;
+
+	if(count <= 0){
+		return FALSE;
+	}
+	d2 = (double *) malloc(count * sizeof(double));
+	sums = (double *) malloc((size_t) k * dim * sizeof(double));
+	totals = (double *) malloc(k * sizeof(double));
+	labels = (int *) malloc(count * sizeof(int));
+	old = (int *) malloc(count * sizeof(int));
+	tile = createTile(dim);
+	if(d2 == NULL || sums == NULL || totals == NULL || labels == NULL || old == NULL || tile == NULL){
+		free(d2);
+		free(sums);
+		free(totals);
+		free(labels);
+		free(old);
+		free(tile);
+		return FALSE;
+	}
+
+	/* weighted k-means++ */
+	for(j = 0; j < k; j++){
+		for(i = 0, total = 0; i < count; i++){
+			total += j == 0 ? weights[i] : d2[i];
+		}
+		target = randomUnit() * total;
+		for(i = 0; i < count - 1 && (target >= (j == 0 ? weights[i] : d2[i])); i++){
+			target -= j == 0 ? weights[i] : d2[i];
+		}
+		if(total <= 0){
+			i = randomPoint(count);
+		}
+		memcpy(c + (size_t) j * dim, candidates + (size_t) i * dim, dim * sizeof(float));
+
+		for(i = 0; i < count; i++){
+			d = weights[i] * squareDistance(candidates + (size_t) i * dim, c + (size_t) j * dim, dim);
+			if(j == 0 || d < d2[i]){
+				d2[i] = d;
+			}
+		}
+	}
+
+	/* weighted Lloyd iterations */
+	for(i = 0; i < count; i++){
+		labels[i] = -1;
+	}
+	for(loops = 0, changed = TRUE; changed && loops < RECLUSTER_LOOPS; loops++){
+		memcpy(old, labels, count * sizeof(int));
+		assignWith(kernel, generic, candidates, dim, 0, count, c, k, labels, tile);
+
+		memset(sums, 0, (size_t) k * dim * sizeof(double));
+		memset(totals, 0, k * sizeof(double));
+		for(i = 0, changed = FALSE; i < count; i++){
+			changed |= labels[i] != old[i];
+			totals[labels[i]] += weights[i];
+			for(t = 0; t < dim; t++){
+				sums[(size_t) labels[i] * dim + t] += (double) weights[i] * candidates[(size_t) i * dim + t];
+			}
+		}
+		for(j = 0; j < k; j++){
+			/* a centroid nothing is closest to stays where it is */
+			for(t = 0; totals[j] > 0 && t < dim; t++){
+				c[(size_t) j * dim + t] = sums[(size_t) j * dim + t] / totals[j];
+			}
+		}
+	}
+
+	free(d2);
+	free(sums);
+	free(totals);
+	free(labels);
+	free(old);
+	free(tile);
+
+	return TRUE;
+}
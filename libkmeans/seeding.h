@@ -0,0 +1,32 @@
+/*
+ * seeding.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef SEEDING_H_
+#define SEEDING_H_
+
+#include "common.h"
+
+/* ways to create the initial centroids */
+#define INIT_CHUNKS 0	/* the first point of k chunks of the data */
+#define INIT_RANDOM 1	/* random coordinates within the range of the data */
+#define INIT_PLUSPLUS 2	/* k-means++ */
+
+/* most weighted Lloyd iterations over the candidates of k-means|| */
+#define RECLUSTER_LOOPS 100
+
+int randomPoint(int size);
+
+double randomUnit();
+
+void randomCentroids(float *data, int size, int dim, int k, float *c);
+
+double squareDistance(float *a, float *b, int dim);
+
+void plusPlusCentroids(float *data, int size, int dim, int k, float *c);
+
+int reclusterCandidates(float *candidates, long *weights, int count, int dim, int k, int kernel, int generic, float *c);
+
+#endif /* SEEDING_H_ */